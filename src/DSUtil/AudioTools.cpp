@@ -20,6 +20,8 @@
 
 #include "stdafx.h"
 #include "math.h"
+#include <immintrin.h>
+#include "CPUInfo.h"
 #include "AudioTools.h"
 
 #define INT8_PEAK       128
@@ -99,6 +101,198 @@ void gain_double(const double factor, const size_t allsamples, double* pData)
     }
 }
 
+// per-channel gains
+// the factors are repeated for GAIN_ROW_FRAMES frames, so the row always holds a multiple
+// of 8 samples and can be walked with 4 or 8 samples per step regardless of the channel count
+
+#define GAIN_ROW_FRAMES 8
+
+static size_t fill_gain_row(double* row, const double* factors, const unsigned channels)
+{
+    for (unsigned i = 0; i < GAIN_ROW_FRAMES; i++) {
+        memcpy(row + i * channels, factors, channels * sizeof(double));
+    }
+    return channels * GAIN_ROW_FRAMES;
+}
+
+static inline __m256i mul_epi32_pd(const __m256i v, const double* factors)
+{
+    const __m256d lo = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), _mm256_loadu_pd(factors));
+    const __m256d hi = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), _mm256_loadu_pd(factors + 4));
+    return _mm256_set_m128i(_mm256_cvttpd_epi32(hi), _mm256_cvttpd_epi32(lo));
+}
+
+void gain_uint8_ch(const double* factors, const unsigned channels, const size_t allsamples, uint8_t* pData)
+{
+    double row[GAIN_ROW_FRAMES * 32];
+    const size_t rowsize = fill_gain_row(row, factors, channels);
+    size_t i = 0, j = 0;
+
+    if (CPUInfo::HaveAVX2()) {
+        const __m128i sign = _mm_set1_epi8(-128);
+        for (; i + 8 <= allsamples; i += 8) {
+            const __m128i s = _mm_xor_si128(_mm_loadl_epi64((const __m128i*)(pData + i)), sign);
+            const __m256i r = mul_epi32_pd(_mm256_cvtepi8_epi32(s), &row[j]);
+            __m128i d = _mm_packs_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+            d = _mm_xor_si128(_mm_packs_epi16(d, d), sign);
+            _mm_storel_epi64((__m128i*)(pData + i), d);
+            if ((j += 8) == rowsize) {
+                j = 0;
+            }
+        }
+    }
+
+    for (; i < allsamples; i++) {
+        const int8_t sample = (int8_t)(row[j] * (int8_t)(pData[i] ^ 0x80));
+        pData[i] = (uint8_t)sample ^ 0x80;
+        if (++j == rowsize) {
+            j = 0;
+        }
+    }
+}
+
+void gain_int16_ch(const double* factors, const unsigned channels, const size_t allsamples, int16_t* pData)
+{
+    double row[GAIN_ROW_FRAMES * 32];
+    const size_t rowsize = fill_gain_row(row, factors, channels);
+    size_t i = 0, j = 0;
+
+    if (CPUInfo::HaveAVX2()) {
+        for (; i + 8 <= allsamples; i += 8) {
+            const __m256i r = mul_epi32_pd(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(pData + i))), &row[j]);
+            _mm_storeu_si128((__m128i*)(pData + i), _mm_packs_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1)));
+            if ((j += 8) == rowsize) {
+                j = 0;
+            }
+        }
+    }
+
+    for (; i < allsamples; i++) {
+        pData[i] = (int16_t)(row[j] * pData[i]);
+        if (++j == rowsize) {
+            j = 0;
+        }
+    }
+}
+
+void gain_int24_ch(const double* factors, const unsigned channels, const size_t allsamples, BYTE* pData)
+{
+    double row[GAIN_ROW_FRAMES * 32];
+    const size_t rowsize = fill_gain_row(row, factors, channels);
+    size_t i = 0, j = 0;
+
+    if (CPUInfo::HaveAVX2()) {
+        // 8 samples (24 bytes) per step, the second load reads 4 bytes more
+        const __m128i unpack = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        const __m128i pack   = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+        for (; i + 10 <= allsamples; i += 8) {
+            BYTE* p = pData + i * 3;
+            const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), unpack);
+            const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 12)), unpack);
+            const __m256i r = mul_epi32_pd(_mm256_set_m128i(b, a), &row[j]);
+            const __m128i ra = _mm_shuffle_epi8(_mm256_castsi256_si128(r), pack);
+            const __m128i rb = _mm_shuffle_epi8(_mm256_extracti128_si256(r, 1), pack);
+            _mm_storel_epi64((__m128i*)p, ra);
+            const int32_t a_tail = _mm_cvtsi128_si32(_mm_srli_si128(ra, 8));
+            memcpy(p + 8, &a_tail, 4);
+            _mm_storel_epi64((__m128i*)(p + 12), rb);
+            const int32_t b_tail = _mm_cvtsi128_si32(_mm_srli_si128(rb, 8));
+            memcpy(p + 20, &b_tail, 4);
+            if ((j += 8) == rowsize) {
+                j = 0;
+            }
+        }
+    }
+
+    for (BYTE* p = pData + i * 3; i < allsamples; i++, p += 3) {
+        int32_t i32 = 0;
+        BYTE* b = (BYTE*)(&i32);
+        b[1] = p[0];
+        b[2] = p[1];
+        b[3] = p[2];
+        i32 = (int32_t)(row[j] * i32);
+        p[0] = b[1];
+        p[1] = b[2];
+        p[2] = b[3];
+        if (++j == rowsize) {
+            j = 0;
+        }
+    }
+}
+
+void gain_int32_ch(const double* factors, const unsigned channels, const size_t allsamples, int32_t* pData)
+{
+    double row[GAIN_ROW_FRAMES * 32];
+    const size_t rowsize = fill_gain_row(row, factors, channels);
+    size_t i = 0, j = 0;
+
+    if (CPUInfo::HaveAVX2()) {
+        for (; i + 8 <= allsamples; i += 8) {
+            const __m256i r = mul_epi32_pd(_mm256_loadu_si256((const __m256i*)(pData + i)), &row[j]);
+            _mm256_storeu_si256((__m256i*)(pData + i), r);
+            if ((j += 8) == rowsize) {
+                j = 0;
+            }
+        }
+    }
+
+    for (; i < allsamples; i++) {
+        pData[i] = (int32_t)(row[j] * pData[i]);
+        if (++j == rowsize) {
+            j = 0;
+        }
+    }
+}
+
+void gain_float_ch(const double* factors, const unsigned channels, const size_t allsamples, float* pData)
+{
+    double row[GAIN_ROW_FRAMES * 32];
+    const size_t rowsize = fill_gain_row(row, factors, channels);
+    size_t i = 0, j = 0;
+
+    if (CPUInfo::HaveAVX2()) {
+        for (; i + 8 <= allsamples; i += 8) {
+            const __m256 v = _mm256_loadu_ps(pData + i);
+            const __m256d lo = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), _mm256_loadu_pd(&row[j]));
+            const __m256d hi = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), _mm256_loadu_pd(&row[j + 4]));
+            _mm256_storeu_ps(pData + i, _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo)));
+            if ((j += 8) == rowsize) {
+                j = 0;
+            }
+        }
+    }
+
+    for (; i < allsamples; i++) {
+        pData[i] = (float)(row[j] * pData[i]);
+        if (++j == rowsize) {
+            j = 0;
+        }
+    }
+}
+
+void gain_double_ch(const double* factors, const unsigned channels, const size_t allsamples, double* pData)
+{
+    double row[GAIN_ROW_FRAMES * 32];
+    const size_t rowsize = fill_gain_row(row, factors, channels);
+    size_t i = 0, j = 0;
+
+    if (CPUInfo::HaveAVX2()) {
+        for (; i + 4 <= allsamples; i += 4) {
+            _mm256_storeu_pd(pData + i, _mm256_mul_pd(_mm256_loadu_pd(pData + i), _mm256_loadu_pd(&row[j])));
+            if ((j += 4) == rowsize) {
+                j = 0;
+            }
+        }
+    }
+
+    for (; i < allsamples; i++) {
+        pData[i] = row[j] * pData[i];
+        if (++j == rowsize) {
+            j = 0;
+        }
+    }
+}
+
 // get_peaks
 
 double get_max_peak_uint8(uint8_t* pData, const size_t allsamples)
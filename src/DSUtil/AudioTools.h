@@ -32,6 +32,15 @@ void gain_int32 (const double factor, const size_t allsamples, int32_t* pData);
 void gain_float (const double factor, const size_t allsamples, float*   pData);
 void gain_double(const double factor, const size_t allsamples, double*  pData);
 
+// per-channel gains for interleaved data, 'factors' holds one factor for each channel (up to 32).
+// factors must not exceed 1.0, no limiter is applied.
+void gain_uint8_ch (const double* factors, const unsigned channels, const size_t allsamples, uint8_t* pData);
+void gain_int16_ch (const double* factors, const unsigned channels, const size_t allsamples, int16_t* pData);
+void gain_int24_ch (const double* factors, const unsigned channels, const size_t allsamples, BYTE*    pData);
+void gain_int32_ch (const double* factors, const unsigned channels, const size_t allsamples, int32_t* pData);
+void gain_float_ch (const double* factors, const unsigned channels, const size_t allsamples, float*   pData);
+void gain_double_ch(const double* factors, const unsigned channels, const size_t allsamples, double*  pData);
+
 double get_max_peak_uint8 (uint8_t* pData, const size_t allsamples);
 double get_max_peak_int16 (int16_t* pData, const size_t allsamples);
 double get_max_peak_int24 (BYTE*    pData, const size_t allsamples);
@@ -20,6 +20,8 @@
  */
 
 #include "stdafx.h"
+#include "Log.h"
+#include "DSUtil.h"
 #include "FontInstaller.h"
 
 CFontInstaller::CFontInstaller()
@@ -33,6 +35,12 @@ CFontInstaller::~CFontInstaller()
 
 void CFontInstaller::UninstallFonts()
 {
+	m_bCancel = true;
+	WaitFonts();
+	m_bCancel = false;
+
+	std::lock_guard lock(m_mutex);
+
 	for (const auto& font : m_fonts) {
 		RemoveFontMemResourceEx(font);
 	}
@@ -58,6 +66,7 @@ bool CFontInstaller::InstallFontMemory(const void* pData, UINT len)
 	DWORD nFonts = 0;
 	HANDLE hFont = AddFontMemResourceEx((PVOID)pData, len, nullptr, &nFonts);
 	if (hFont && nFonts > 0) {
+		std::lock_guard lock(m_mutex);
 		m_fonts.push_back(hFont);
 	}
 	return hFont && nFonts > 0;
@@ -94,3 +103,33 @@ bool CFontInstaller::InstallFontTempFile(const void* pData, UINT len)
 	DeleteFileW(fn);
 	return false;
 }
+
+void CFontInstaller::InstallFontsMemoryAsync(std::vector<std::vector<BYTE>>&& fonts)
+{
+	WaitFonts();
+
+	if (fonts.empty()) {
+		return;
+	}
+
+	m_thread = std::thread([this, fonts = std::move(fonts)] {
+		const auto start = GetPerfCounter();
+		size_t n = 0;
+		for (const auto& font : fonts) {
+			if (m_bCancel) {
+				break;
+			}
+			n += InstallFontMemory(font.data(), (UINT)font.size());
+		}
+		DLog(L"CFontInstaller : installed %Iu of %Iu fonts in %.1f ms", n, fonts.size(), (GetPerfCounter() - start) / 10000.0);
+	});
+}
+
+void CFontInstaller::WaitFonts()
+{
+	if (m_thread.joinable()) {
+		const auto start = GetPerfCounter();
+		m_thread.join();
+		DLog(L"CFontInstaller::WaitFonts() : waited %.1f ms", (GetPerfCounter() - start) / 10000.0);
+	}
+}
@@ -21,12 +21,20 @@
 
 #pragma once
 
+#include <mutex>
+#include <thread>
+#include <atomic>
+
 class CFontInstaller
 {
 	std::list<HANDLE> m_fonts;
 	std::list<CString> m_files;
 	std::list<CString> m_tempfiles;
 
+	std::mutex m_mutex;
+	std::thread m_thread;
+	std::atomic<bool> m_bCancel = false;
+
 public:
 	CFontInstaller();
 	virtual ~CFontInstaller();
@@ -35,5 +43,10 @@ public:
 	bool InstallFontFile(LPCWSTR filename);
 	bool InstallFontTempFile(const void* pData, UINT len);
 
+	// installs the fonts on a background thread
+	void InstallFontsMemoryAsync(std::vector<std::vector<BYTE>>&& fonts);
+	// waits until the fonts passed to InstallFontsMemoryAsync() are installed
+	void WaitFonts();
+
 	void UninstallFonts();
 };
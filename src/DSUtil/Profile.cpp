@@ -26,6 +26,7 @@
 #include "FileHandle.h"
 #include "Utils.h"
 #include "Log.h"
+#include "DSUtil.h"
 #include "Profile.h"
 
 CStringW GetIniProgramDir()
@@ -52,6 +53,19 @@ CStringW GetIniUserProfile()
 	return path;
 }
 
+static bool GetFileStamp(const CStringW& path, UINT64& size, UINT64& time)
+{
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!GetFileAttributesExW(path, GetFileExInfoStandard, &fad)) {
+		size = time = 0;
+		return false;
+	}
+
+	size = ((UINT64)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+	time = ((UINT64)fad.ftLastWriteTime.dwHighDateTime << 32) | fad.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
 // CProfile
 
 CProfile::CProfile()
@@ -100,13 +114,26 @@ void CProfile::InitIni()
 		return;
 	}
 
-	m_bIniFirstInit = true;
 	m_dwIniLastAccessTick = tick;
 
-	if (!::PathFileExistsW(m_IniPath)) {
+	// Don't reread mpc-be.ini if it has not been changed since the last reading or writing
+	UINT64 size, time;
+	const bool bExists = GetFileStamp(m_IniPath, size, time);
+	if (m_bIniFirstInit && size == m_IniFileSize && time == m_IniFileTime) {
 		return;
 	}
 
+	m_bIniFirstInit = true;
+	m_IniFileSize = size;
+	m_IniFileTime = time;
+
+	if (!bExists) {
+		PublishIniSnapshot();
+		return;
+	}
+
+	const auto start = GetPerfCounter();
+
 	FILE* fp;
 	int fpStatus;
 	do { // Open mpc-be.ini in UNICODE mode, retry if it is already being used by another process
@@ -171,9 +198,63 @@ void CProfile::InitIni()
 	fpStatus = fclose(fp);
 	ASSERT(fpStatus == 0);
 
+	PublishIniSnapshot();
+
+	DLog(L"CProfile::InitIni() : parsed in %.3f ms", (GetPerfCounter() - start) / 10000.0);
+
 	m_dwIniLastAccessTick = GetTickCount(); // update the last access tick because reading the file can take a long time
 }
 
+void CProfile::PublishIniSnapshot()
+{
+	std::atomic_store(&m_pIniSnapshot, std::make_shared<const ProfileMap>(m_ProfileMap));
+	m_bIniSnapshotOutdated = false;
+}
+
+bool CProfile::GetIniValue(const wchar_t* section, const wchar_t* entry, CStringW& value)
+{
+	auto FindValue = [&](const ProfileMap& profileMap) {
+		auto it1 = profileMap.find(section);
+		if (it1 != profileMap.end()) {
+			auto it2 = it1->second.find(entry);
+			if (it2 != it1->second.end()) {
+				value = it2->second;
+				return true;
+			}
+		}
+		return false;
+	};
+
+	// Read from the immutable snapshot without locking, unless there are unpublished changes
+	// or the file should be checked for changes by another process
+	if (!m_bIniSnapshotOutdated && GetTickCount() - m_dwIniLastAccessTick < 100) {
+		const auto snapshot = std::atomic_load(&m_pIniSnapshot);
+		if (snapshot) {
+			return FindValue(*snapshot);
+		}
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
+	InitIni();
+	return FindValue(m_ProfileMap);
+}
+
+bool CProfile::SetIniValue(const wchar_t* section, const wchar_t* entry, const CStringW& value)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
+	InitIni();
+	CStringW& old = m_ProfileMap[section][entry];
+	if (old != value) {
+		old = value;
+		m_bIniNeedFlush = true;
+		m_bIniSnapshotOutdated = true; // will be published by Flush()
+	}
+
+	return true;
+}
+
 bool CProfile::StoreSettingsTo(const SettingsLocation newLocation)
 {
 	if (newLocation == SETS_REGISTRY) {
@@ -259,11 +340,11 @@ bool CProfile::ReadBool(const wchar_t* section, const wchar_t* entry, bool& valu
 
 bool CProfile::ReadInt(const wchar_t* section, const wchar_t* entry, int& value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Open(m_hAppRegKey, section, KEY_READ)) {
 			if (ERROR_SUCCESS == regkey.QueryDWORDValue(entry, *(DWORD*)&value)) {
@@ -272,13 +353,9 @@ bool CProfile::ReadInt(const wchar_t* section, const wchar_t* entry, int& value)
 			regkey.Close();
 		}
 	} else {
-		InitIni();
-		auto it1 = m_ProfileMap.find(section);
-		if (it1 != m_ProfileMap.end()) {
-			auto it2 = it1->second.find(entry);
-			if (it2 != it1->second.end()) {
-				ret = StrToInt32(it2->second, value);
-			}
+		CStringW valueStr;
+		if (GetIniValue(section, entry, valueStr)) {
+			ret = StrToInt32(valueStr, value);
 		}
 	}
 
@@ -302,11 +379,11 @@ bool CProfile::ReadInt(const wchar_t* section, const wchar_t* entry, int& value,
 
 bool CProfile::ReadUInt(const wchar_t* section, const wchar_t* entry, unsigned& value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Open(m_hAppRegKey, section, KEY_READ)) {
 			if (ERROR_SUCCESS == regkey.QueryDWORDValue(entry, *(DWORD*)&value)) {
@@ -316,13 +393,9 @@ bool CProfile::ReadUInt(const wchar_t* section, const wchar_t* entry, unsigned&
 		}
 	}
 	else {
-		InitIni();
-		auto it1 = m_ProfileMap.find(section);
-		if (it1 != m_ProfileMap.end()) {
-			auto it2 = it1->second.find(entry);
-			if (it2 != it1->second.end()) {
-				ret = StrToUInt32(it2->second, value);
-			}
+		CStringW valueStr;
+		if (GetIniValue(section, entry, valueStr)) {
+			ret = StrToUInt32(valueStr, value);
 		}
 	}
 
@@ -347,11 +420,11 @@ bool CProfile::ReadUInt(const wchar_t* section, const wchar_t* entry, unsigned&
 
 bool CProfile::ReadInt64(const wchar_t* section, const wchar_t* entry, __int64& value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Open(m_hAppRegKey, section, KEY_READ)) {
 			if (ERROR_SUCCESS == regkey.QueryQWORDValue(entry, *(ULONGLONG*)&value)) {
@@ -360,13 +433,9 @@ bool CProfile::ReadInt64(const wchar_t* section, const wchar_t* entry, __int64&
 			regkey.Close();
 		}
 	} else {
-		InitIni();
-		auto it1 = m_ProfileMap.find(section);
-		if (it1 != m_ProfileMap.end()) {
-			auto it2 = it1->second.find(entry);
-			if (it2 != it1->second.end()) {
-				ret = StrToInt64(it2->second, value);
-			}
+		CStringW valueStr;
+		if (GetIniValue(section, entry, valueStr)) {
+			ret = StrToInt64(valueStr, value);
 		}
 	}
 
@@ -390,11 +459,11 @@ bool CProfile::ReadInt64(const wchar_t* section, const wchar_t* entry, __int64&
 
 bool CProfile::ReadDouble(const wchar_t* section, const wchar_t* entry, double& value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Open(m_hAppRegKey, section, KEY_READ)) {
 			ULONG nChars = 0;
@@ -407,13 +476,9 @@ bool CProfile::ReadDouble(const wchar_t* section, const wchar_t* entry, double&
 			regkey.Close();
 		}
 	} else {
-		InitIni();
-		auto it1 = m_ProfileMap.find(section);
-		if (it1 != m_ProfileMap.end()) {
-			auto it2 = it1->second.find(entry);
-			if (it2 != it1->second.end()) {
-				ret = StrToDouble(it2->second, value);
-			}
+		CStringW valueStr;
+		if (GetIniValue(section, entry, valueStr)) {
+			ret = StrToDouble(valueStr, value);
 		}
 	}
 
@@ -437,11 +502,11 @@ bool CProfile::ReadDouble(const wchar_t* section, const wchar_t* entry, double&
 
 bool CProfile::ReadHex32(const wchar_t* section, const wchar_t* entry, unsigned& value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Open(m_hAppRegKey, section, KEY_READ)) {
 			if (ERROR_SUCCESS == regkey.QueryDWORDValue(entry, *(DWORD*)&value)) {
@@ -451,13 +516,9 @@ bool CProfile::ReadHex32(const wchar_t* section, const wchar_t* entry, unsigned&
 		}
 	}
 	else {
-		InitIni();
-		auto it1 = m_ProfileMap.find(section);
-		if (it1 != m_ProfileMap.end()) {
-			auto it2 = it1->second.find(entry);
-			if (it2 != it1->second.end()) {
-				ret = StrHexToUInt32(it2->second, value);
-			}
+		CStringW valueStr;
+		if (GetIniValue(section, entry, valueStr)) {
+			ret = StrHexToUInt32(valueStr, value);
 		}
 	}
 
@@ -466,11 +527,11 @@ bool CProfile::ReadHex32(const wchar_t* section, const wchar_t* entry, unsigned&
 
 bool CProfile::ReadString(const wchar_t* section, const wchar_t* entry, CStringW& value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Open(m_hAppRegKey, section, KEY_READ)) {
 			ULONG nChars = 0;
@@ -482,15 +543,7 @@ bool CProfile::ReadString(const wchar_t* section, const wchar_t* entry, CStringW
 			regkey.Close();
 		}
 	} else {
-		InitIni();
-		auto it1 = m_ProfileMap.find(section);
-		if (it1 != m_ProfileMap.end()) {
-			auto it2 = it1->second.find(entry);
-			if (it2 != it1->second.end()) {
-				value = it2->second;
-				ret = true;
-			}
-		}
+		ret = GetIniValue(section, entry, value);
 	}
 
 	return ret;
@@ -498,11 +551,11 @@ bool CProfile::ReadString(const wchar_t* section, const wchar_t* entry, CStringW
 
 bool CProfile::ReadBinaryOld(const wchar_t* section, const wchar_t* entry, BYTE** ppdata, unsigned& nbytes)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Open(m_hAppRegKey, section, KEY_READ)) {
 			if (ERROR_SUCCESS == regkey.QueryBinaryValue(entry, NULL, (ULONG*)&nbytes)) {
@@ -516,14 +569,7 @@ bool CProfile::ReadBinaryOld(const wchar_t* section, const wchar_t* entry, BYTE*
 	} else {
 		CStringW valueStr;
 
-		InitIni();
-		auto it1 = m_ProfileMap.find(section);
-		if (it1 != m_ProfileMap.end()) {
-			auto it2 = it1->second.find(entry);
-			if (it2 != it1->second.end()) {
-				valueStr = it2->second;
-			}
-		}
+		GetIniValue(section, entry, valueStr);
 
 		if (valueStr.IsEmpty()) {
 			return false;
@@ -557,11 +603,11 @@ bool CProfile::ReadBinaryOld(const wchar_t* section, const wchar_t* entry, BYTE*
 
 bool CProfile::ReadBinary(const wchar_t* section, const wchar_t* entry, BYTE** ppdata, unsigned& nbytes)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Open(m_hAppRegKey, section, KEY_READ)) {
 			if (ERROR_SUCCESS == regkey.QueryBinaryValue(entry, NULL, (ULONG*)&nbytes)) {
@@ -575,14 +621,7 @@ bool CProfile::ReadBinary(const wchar_t* section, const wchar_t* entry, BYTE** p
 	} else {
 		CStringW valueStr;
 
-		InitIni();
-		auto it1 = m_ProfileMap.find(section);
-		if (it1 != m_ProfileMap.end()) {
-			auto it2 = it1->second.find(entry);
-			if (it2 != it1->second.end()) {
-				valueStr = it2->second;
-			}
-		}
+		GetIniValue(section, entry, valueStr);
 
 		CStringA base64(valueStr);
 		if (base64.IsEmpty()) {
@@ -616,11 +655,11 @@ bool CProfile::WriteBool(const wchar_t* section, const wchar_t* entry, const boo
 
 bool CProfile::WriteInt(const wchar_t* section, const wchar_t* entry, const int value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Create(m_hAppRegKey, section)) {
 			if (ERROR_SUCCESS == regkey.SetDWORDValue(entry, (DWORD)value)) {
@@ -629,15 +668,9 @@ bool CProfile::WriteInt(const wchar_t* section, const wchar_t* entry, const int
 			regkey.Close();
 		}
 	} else {
-		InitIni();
 		CStringW valueStr;
 		valueStr.Format(L"%d", value);
-		CStringW& old = m_ProfileMap[section][entry];
-		if (old != valueStr) {
-			old = valueStr;
-			m_bIniNeedFlush = true;
-		}
-		ret = true;
+		ret = SetIniValue(section, entry, valueStr);
 	}
 
 	return ret;
@@ -645,11 +678,11 @@ bool CProfile::WriteInt(const wchar_t* section, const wchar_t* entry, const int
 
 bool CProfile::WriteUInt(const wchar_t* section, const wchar_t* entry, const unsigned value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Create(m_hAppRegKey, section)) {
 			if (ERROR_SUCCESS == regkey.SetDWORDValue(entry, (DWORD)value)) {
@@ -659,15 +692,9 @@ bool CProfile::WriteUInt(const wchar_t* section, const wchar_t* entry, const uns
 		}
 	}
 	else {
-		InitIni();
 		CStringW valueStr;
 		valueStr.Format(L"%u", value);
-		CStringW& old = m_ProfileMap[section][entry];
-		if (old != valueStr) {
-			old = valueStr;
-			m_bIniNeedFlush = true;
-		}
-		ret = true;
+		ret = SetIniValue(section, entry, valueStr);
 	}
 
 	return ret;
@@ -675,11 +702,11 @@ bool CProfile::WriteUInt(const wchar_t* section, const wchar_t* entry, const uns
 
 bool CProfile::WriteInt64(const wchar_t* section, const wchar_t* entry, const __int64 value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Create(m_hAppRegKey, section)) {
 			if (ERROR_SUCCESS == regkey.SetQWORDValue(entry, (ULONGLONG)value)) {
@@ -691,13 +718,7 @@ bool CProfile::WriteInt64(const wchar_t* section, const wchar_t* entry, const __
 		CStringW valueStr;
 		valueStr.Format(L"%I64d", value);
 
-		InitIni();
-		CStringW& old = m_ProfileMap[section][entry];
-		if (old != valueStr) {
-			old = valueStr;
-			m_bIniNeedFlush = true;
-		}
-		ret = true;
+		ret = SetIniValue(section, entry, valueStr);
 	}
 
 	return ret;
@@ -705,14 +726,14 @@ bool CProfile::WriteInt64(const wchar_t* section, const wchar_t* entry, const __
 
 bool CProfile::WriteDouble(const wchar_t* section, const wchar_t* entry, const double value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	CStringW valueStr;
 	valueStr.Format(L"%.4f", value);
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Create(m_hAppRegKey, section)) {
 			if (ERROR_SUCCESS == regkey.SetStringValue(entry, valueStr)) {
@@ -721,13 +742,7 @@ bool CProfile::WriteDouble(const wchar_t* section, const wchar_t* entry, const d
 			regkey.Close();
 		}
 	} else {
-		InitIni();
-		CStringW& old = m_ProfileMap[section][entry];
-		if (old != valueStr) {
-			old = valueStr;
-			m_bIniNeedFlush = true;
-		}
-		ret = true;
+		ret = SetIniValue(section, entry, valueStr);
 	}
 
 	return ret;
@@ -735,11 +750,11 @@ bool CProfile::WriteDouble(const wchar_t* section, const wchar_t* entry, const d
 
 bool CProfile::WriteHex32(const wchar_t* section, const wchar_t* entry, const unsigned value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Create(m_hAppRegKey, section)) {
 			if (ERROR_SUCCESS == regkey.SetDWORDValue(entry, (DWORD)value)) {
@@ -749,15 +764,9 @@ bool CProfile::WriteHex32(const wchar_t* section, const wchar_t* entry, const un
 		}
 	}
 	else {
-		InitIni();
 		CStringW valueStr;
 		valueStr.Format(L"0x%06X", value);
-		CStringW& old = m_ProfileMap[section][entry];
-		if (old != valueStr) {
-			old = valueStr;
-			m_bIniNeedFlush = true;
-		}
-		ret = true;
+		ret = SetIniValue(section, entry, valueStr);
 	}
 
 	return ret;
@@ -765,11 +774,11 @@ bool CProfile::WriteHex32(const wchar_t* section, const wchar_t* entry, const un
 
 bool CProfile::WriteString(const wchar_t* section, const wchar_t* entry, const CStringW& value)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Create(m_hAppRegKey, section)) {
 			if (ERROR_SUCCESS == regkey.SetStringValue(entry, value)) {
@@ -778,13 +787,7 @@ bool CProfile::WriteString(const wchar_t* section, const wchar_t* entry, const C
 			regkey.Close();
 		}
 	} else {
-		InitIni();
-		CStringW& old = m_ProfileMap[section][entry];
-		if (old != value) {
-			old = value;
-			m_bIniNeedFlush = true;
-		}
-		ret = true;
+		ret = SetIniValue(section, entry, value);
 	}
 
 	return ret;
@@ -792,11 +795,11 @@ bool CProfile::WriteString(const wchar_t* section, const wchar_t* entry, const C
 
 bool CProfile::WriteBinaryOld(const wchar_t* section, const wchar_t* entry, const BYTE* pdata, const unsigned nbytes)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Create(m_hAppRegKey, section)) {
 			if (ERROR_SUCCESS == regkey.SetBinaryValue(entry, pdata, nbytes)) {
@@ -815,13 +818,7 @@ bool CProfile::WriteBinaryOld(const wchar_t* section, const wchar_t* entry, cons
 		}
 		valueStr.ReleaseBufferSetLength(nbytes * 2);
 
-		InitIni();
-		CStringW& old = m_ProfileMap[section][entry];
-		if (old != valueStr) {
-			old = valueStr;
-			m_bIniNeedFlush = true;
-		}
-		ret = true;
+		ret = SetIniValue(section, entry, valueStr);
 	}
 
 	return ret;
@@ -829,11 +826,11 @@ bool CProfile::WriteBinaryOld(const wchar_t* section, const wchar_t* entry, cons
 
 bool CProfile::WriteBinary(const wchar_t* section, const wchar_t* entry, const BYTE* pdata, const unsigned nbytes)
 {
-	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-
 	bool ret = false;
 
 	if (m_hAppRegKey) {
+		std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+
 		CRegKey regkey;
 		if (ERROR_SUCCESS == regkey.Create(m_hAppRegKey, section)) {
 			if (ERROR_SUCCESS == regkey.SetBinaryValue(entry, pdata, nbytes)) {
@@ -849,13 +846,7 @@ bool CProfile::WriteBinary(const wchar_t* section, const wchar_t* entry, const B
 		if (encOk) {
 			base64.ReleaseBufferSetLength(nDestLen);
 			CStringW valueStr(base64);
-			InitIni();
-			CStringW& old = m_ProfileMap[section][entry];
-			if (old != valueStr) {
-				old = valueStr;
-				m_bIniNeedFlush = true;
-			}
-			ret = true;
+			ret = SetIniValue(section, entry, valueStr);
 		}
 	}
 
@@ -946,6 +937,7 @@ bool CProfile::DeleteValue(const wchar_t* section, const wchar_t* entry)
 		if (it != m_ProfileMap.end()) {
 			if (it->second.erase(entry)) {
 				m_bIniNeedFlush = true;
+				m_bIniSnapshotOutdated = true;
 				ret = true;
 			}
 		}
@@ -973,6 +965,7 @@ bool CProfile::DeleteSection(const wchar_t* section)
 		InitIni();
 		if (m_ProfileMap.erase(section)) {
 			m_bIniNeedFlush = true;
+			m_bIniSnapshotOutdated = true;
 			ret = true;
 		}
 	}
@@ -988,45 +981,92 @@ void CProfile::Flush(bool bForce)
 
 	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
 
-	m_bIniNeedFlush = false;
+	if (!bForce && m_dwIniFlushFailTick && GetTickCount() - m_dwIniFlushFailTick < 10000) {
+		return;
+	}
 
 	ASSERT(m_bIniFirstInit);
 	ASSERT(m_IniPath.GetLength());
 
-	FILE* fp;
-	int fpStatus;
-	do { // Open mpc-be.ini, retry if it is already being used by another process
-		fp = _wfsopen(m_IniPath, L"w, ccs=UTF-8", _SH_SECURE);
-		if (fp || (GetLastError() != ERROR_SHARING_VIOLATION)) {
+	const auto start = GetPerfCounter();
+
+	// Build the whole file in memory, write it to a temporary file and replace mpc-be.ini with it,
+	// so other processes never see a partially written file
+	CStringW text(L"; MPC-BE\n");
+	for (const auto& [section, entries] : m_ProfileMap) {
+		text.AppendFormat(L"[%s]\n", section);
+		for (const auto& [name, value] : entries) {
+			text.AppendFormat(L"%s=%s\n", name, value);
+		}
+	}
+
+	// Another process that reads or replaces the file at the same time makes our open or replace
+	// fail with a sharing violation or, while its replace is in progress, with access denied
+	auto RetryLater = [](int attempt) {
+		const DWORD error = GetLastError();
+		if (attempt < 10 && (error == ERROR_SHARING_VIOLATION || error == ERROR_ACCESS_DENIED)) {
+			Sleep(100);
+			return true;
+		}
+		return false;
+	};
+
+	// on failure m_bIniNeedFlush stays set, the changes are kept in memory for the next attempt
+	auto OnFailure = [&]() {
+		ASSERT(FALSE);
+		m_dwIniFlushFailTick = GetTickCount() | 1;
+	};
+
+	const CStringW tmpPath = m_IniPath + L".tmp";
+
+	FILE* fp = nullptr;
+	for (int attempt = 0; ; attempt++) {
+		fp = _wfsopen(tmpPath, L"w, ccs=UTF-8", _SH_DENYRW);
+		if (fp || !RetryLater(attempt)) {
 			break;
 		}
-		Sleep(100);
-	} while (true);
+	}
 	if (!fp) {
-		ASSERT(FALSE);
+		OnFailure();
 		return;
 	}
 	CStdioFile file(fp);
-	CStringW line;
+	bool ret = true;
 	try {
-		file.WriteString(L"; MPC-BE\n");
-		for (auto it1 = m_ProfileMap.begin(); it1 != m_ProfileMap.end(); ++it1) {
-			line.Format(L"[%s]\n", it1->first);
-			file.WriteString(line);
-			for (auto it2 = it1->second.begin(); it2 != it1->second.end(); ++it2) {
-				line.Format(L"%s=%s\n", it2->first, it2->second);
-				file.WriteString(line);
-			}
-		}
+		file.WriteString(text);
+		file.Flush();
 	}
 	catch (CFileException& e) {
 		// Fail silently if disk is full
 		UNREFERENCED_PARAMETER(e);
 		ASSERT(FALSE);
+		ret = false;
 	}
 
-	fpStatus = fclose(fp);
+	const int fpStatus = fclose(fp);
 	ASSERT(fpStatus == 0);
+
+	if (ret) {
+		for (int attempt = 0; ; attempt++) { // Replace mpc-be.ini, retry if it is being used by another process
+			ret = !!MoveFileExW(tmpPath, m_IniPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+			if (ret || !RetryLater(attempt)) {
+				break;
+			}
+		}
+	}
+	if (!ret) {
+		_wremove(tmpPath);
+		OnFailure();
+		return;
+	}
+
+	m_bIniNeedFlush = false;
+	m_dwIniFlushFailTick = 0;
+
+	GetFileStamp(m_IniPath, m_IniFileSize, m_IniFileTime);
+	PublishIniSnapshot();
+
+	DLog(L"CProfile::Flush() : written in %.3f ms", (GetPerfCounter() - start) / 10000.0);
 }
 
 void CProfile::Clear()
@@ -22,6 +22,8 @@
 
 #include <mutex>
 #include <map>
+#include <memory>
+#include <atomic>
 
 enum SettingsLocation {
 	SETS_REGISTRY,
@@ -45,10 +47,18 @@ private:
 			return str1.CompareNoCase(str2) < 0;
 		}
 	};
-	std::map<CStringW, std::map<CStringW, CStringW, KeyCmp>, KeyCmp> m_ProfileMap;
+	typedef std::map<CStringW, std::map<CStringW, CStringW, KeyCmp>, KeyCmp> ProfileMap;
+	ProfileMap m_ProfileMap; // working copy, protected by m_Mutex
+	// Immutable copy of m_ProfileMap for reading without locking. It is replaced after reading
+	// the file and after Flush(), CStringW buffers are shared with the working copy.
+	std::shared_ptr<const ProfileMap> m_pIniSnapshot;
+	std::atomic<bool> m_bIniSnapshotOutdated = true;
 	bool  m_bIniFirstInit = false;
 	bool  m_bIniNeedFlush = false;
-	DWORD m_dwIniLastAccessTick = 0;
+	DWORD m_dwIniFlushFailTick = 0; // last failed Flush(), delays the next attempt from idle time
+	std::atomic<DWORD> m_dwIniLastAccessTick = 0;
+	UINT64 m_IniFileSize = 0;
+	UINT64 m_IniFileTime = 0;
 
 public:
 	CProfile();
@@ -57,6 +67,9 @@ private:
 	LONG OpenRegistryKey();
 	// read all the fields from the ini file
 	void InitIni();
+	void PublishIniSnapshot();
+	bool GetIniValue(const wchar_t* section, const wchar_t* entry, CStringW& value);
+	bool SetIniValue(const wchar_t* section, const wchar_t* entry, const CStringW& value);
 
 public:
 	bool StoreSettingsTo(const SettingsLocation newLocation);
@@ -118,6 +118,16 @@ public IUnknown {
 	STDMETHOD_(void, SetInverseAlpha)(bool bInverted) PURE;
 };
 
+interface __declspec(uuid("90F264A5-4E09-452D-B43E-15F911AF55CD"))
+ISubPicAllocatorEx :
+public IUnknown {
+	static const int MAX_STATIC = 4;
+
+	// Same as GetStatic() but gives access to several static subpics (index < MAX_STATIC),
+	// index 0 is the one returned by GetStatic().
+	STDMETHOD (GetStaticEx) (int index, ISubPic** ppSubPic /*[out]*/) PURE;
+};
+
 //
 // ISubPicProvider
 //
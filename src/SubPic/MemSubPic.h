@@ -30,6 +30,12 @@ class CMemSubPic : public CSubPicImpl
 protected:
 	SubPicDesc m_spd;
 
+	// rows of m_rcDirty that have at least one visible pixel, recorded by Unlock() when the rendering is done
+	std::vector<bool> m_rowsUsed;
+	bool m_bRowsUsedValid = false;
+
+	void UpdateRowsUsed();
+
 public:
 	CMemSubPic(SubPicDesc& spd);
 	virtual ~CMemSubPic();
@@ -44,6 +50,7 @@ public:
 	STDMETHODIMP Lock(SubPicDesc& spd) override;
 	STDMETHODIMP Unlock(RECT* pDirtyRect) override;
 	STDMETHODIMP AlphaBlt(RECT* pSrc, RECT* pDst, SubPicDesc* pTarget) override;
+	STDMETHODIMP SetDirtyRect(RECT* pDirtyRect) override;
 };
 
 // CMemSubPicAllocator
@@ -252,6 +252,7 @@ STDMETHODIMP CSubPicAllocatorImpl::NonDelegatingQueryInterface(REFIID riid, void
 {
 	return
 		QI(ISubPicAllocator)
+		QI(ISubPicAllocatorEx)
 		__super::NonDelegatingQueryInterface(riid, ppv);
 }
 
@@ -270,24 +271,34 @@ STDMETHODIMP CSubPicAllocatorImpl::SetCurVidRect(RECT curvidrect)
 }
 
 STDMETHODIMP CSubPicAllocatorImpl::GetStatic(ISubPic** ppSubPic)
+{
+	return GetStaticEx(0, ppSubPic);
+}
+
+STDMETHODIMP CSubPicAllocatorImpl::GetStaticEx(int index, ISubPic** ppSubPic)
 {
 	CheckPointer(ppSubPic, E_POINTER);
+	if (index < 0 || index >= MAX_STATIC) {
+		return E_INVALIDARG;
+	}
 
 	{
 		CAutoLock cAutoLock(&m_staticLock);
 
+		auto& pStatic = m_pStatic[index];
+
 		CSize size(0, 0);
-		if (m_pStatic && (FAILED(m_pStatic->GetSize(&size)) || size.cx != m_cursize.cx) || (size.cy != m_cursize.cy)) {
-			m_pStatic.Release();
+		if (pStatic && (FAILED(pStatic->GetSize(&size)) || size.cx != m_cursize.cx || size.cy != m_cursize.cy)) {
+			pStatic.Release();
 		}
 
-		if (!m_pStatic) {
-			if (!Alloc(true, &m_pStatic) || !m_pStatic) {
+		if (!pStatic) {
+			if (!Alloc(true, &pStatic) || !pStatic) {
 				return E_OUTOFMEMORY;
 			}
 		}
 
-		*ppSubPic = m_pStatic;
+		*ppSubPic = pStatic;
 	}
 
 	(*ppSubPic)->AddRef();
@@ -323,7 +334,9 @@ STDMETHODIMP CSubPicAllocatorImpl::Reset()
 {
 	CAutoLock cAutoLock(&m_staticLock);
 
-	m_pStatic.Release();
+	for (auto& pStatic : m_pStatic) {
+		pStatic.Release();
+	}
 	return S_OK;
 }
 
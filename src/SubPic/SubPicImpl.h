@@ -117,11 +117,11 @@ public:
 };
 
 
-class CSubPicAllocatorImpl : public CUnknown, public ISubPicAllocator
+class CSubPicAllocatorImpl : public CUnknown, public ISubPicAllocator, public ISubPicAllocatorEx
 {
 private:
 	CCritSec m_staticLock;
-	CComPtr<ISubPic> m_pStatic;
+	CComPtr<ISubPic> m_pStatic[MAX_STATIC];
 
 	CSize m_cursize;
 	CRect m_curvidrect;
@@ -148,4 +148,8 @@ public:
 	STDMETHODIMP SetMaxTextureSize(SIZE MaxTextureSize) { return E_NOTIMPL; };
 	STDMETHODIMP Reset();
 	STDMETHODIMP_(void) SetInverseAlpha(bool bInverted);
+
+	// ISubPicAllocatorEx
+
+	STDMETHODIMP GetStaticEx(int index, ISubPic** ppSubPic);
 };
@@ -163,6 +163,13 @@ CSubPicQueue::CSubPicQueue(int nMaxSubPic, bool bDisableAnim, bool bAllowDropSub
 		return;
 	}
 
+	// two static subpics are enough to render one while the other one is being copied
+	m_pAllocatorEx = m_pAllocator;
+	const int nStatics = m_pAllocatorEx ? 2 : 1;
+	for (int i = 0; i < nStatics; i++) {
+		m_freeStatics.push_back(i);
+	}
+
 	CAMThread::Create();
 }
 
@@ -171,6 +178,15 @@ CSubPicQueue::~CSubPicQueue()
 	m_bExitThread = true;
 	SetSubPicProvider(nullptr);
 	CAMThread::Close();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutexQueue);
+		m_uploadJobs.clear();
+	}
+	m_condUpload.notify_one();
+	if (m_uploadThread.joinable()) {
+		m_uploadThread.join();
+	}
 }
 
 // ISubPicQueue
@@ -216,7 +232,7 @@ STDMETHODIMP CSubPicQueue::Invalidate(REFERENCE_TIME rtInvalidate)
 	DLog(L"Invalidate: %f", double(rtInvalidate) / 10000000.0);
 #endif
 
-	m_bInvalidate = true;
+	m_nInvalidate++;
 	m_rtInvalidate = rtInvalidate;
 	m_rtNowLast = LONGLONG_ERROR;
 
@@ -238,6 +254,20 @@ STDMETHODIMP CSubPicQueue::Invalidate(REFERENCE_TIME rtInvalidate)
 		m_queue.RemoveTailNoReturn();
 	}
 
+	while (!m_uploadJobs.empty() && m_uploadJobs.back().pStatic->GetStop() > rtInvalidate) {
+		m_freeStatics.push_back(m_uploadJobs.back().iStatic);
+		m_nPendingUploads--;
+		m_uploadJobs.pop_back();
+	}
+	// the remaining jobs are uploaded, the job being copied is dropped by the upload thread if it ends after rtInvalidate
+	if (!m_uploadJobs.empty()) {
+		m_rtPendingStop = m_uploadJobs.back().pStatic->GetStop();
+	} else if (m_rtUploadingStop <= rtInvalidate) {
+		m_rtPendingStop = m_rtUploadingStop;
+	} else {
+		m_rtPendingStop = -1;
+	}
+
 	// If we invalidate in the past, always give the queue a chance to re-render the modified subtitles
 	if (rtInvalidate >= 0 && rtInvalidate < m_rtNow) {
 		m_rtNow = rtInvalidate;
@@ -452,50 +482,85 @@ STDMETHODIMP CSubPicQueue::GetStats(int nSubPic, REFERENCE_TIME& rtStart, REFERE
 
 // private
 
-bool CSubPicQueue::EnqueueSubPic(CComPtr<ISubPic>& pSubPic, bool bBlocking)
+bool CSubPicQueue::CanRenderSubPic() const
 {
-	auto canAddToQueue = [this]() {
-		return (int)m_queue.GetCount() < m_nMaxSubPic;
-	};
+	// the subpics waiting for the upload count as part of the queue
+	return !m_freeStatics.empty() && (int)m_queue.GetCount() + m_nPendingUploads < m_nMaxSubPic;
+}
 
-	bool bAdded = false;
+REFERENCE_TIME CSubPicQueue::GetCurrentRenderingTime()
+{
+	REFERENCE_TIME rtNow = -1;
 
-	std::unique_lock<std::mutex> lock(m_mutexQueue);
-	if (bBlocking) {
-		// Wait for enough room in the queue
-		m_condQueueFull.wait(lock, canAddToQueue);
+	{
+		std::lock_guard<std::mutex> lock(m_mutexQueue);
+
+		if (!m_queue.IsEmpty()) {
+			rtNow = m_queue.GetTail()->GetStop();
+		}
+		if (m_nPendingUploads) {
+			rtNow = std::max(rtNow, m_rtPendingStop);
+		}
+	}
+
+	return std::max(rtNow, m_rtNow);
+}
+
+void CSubPicQueue::UploadSubPic(UploadJob& job, std::unique_lock<std::mutex>& lock)
+{
+	m_rtUploadingStop = job.pStatic->GetStop();
+	lock.unlock();
+
+	CComPtr<ISubPic> pSubPic;
+	const bool bCopied = SUCCEEDED(m_pAllocator->AllocDynamic(&pSubPic)) && SUCCEEDED(job.pStatic->CopyTo(pSubPic));
+	if (bCopied) {
+		if (SUCCEEDED(job.hrTextureSize)) {
+			pSubPic->SetVirtualTextureSize(job.virtualSize, job.virtualTopLeft);
+		}
+		pSubPic->SetType(job.sType);
 	}
+	job.pStatic.Release();
 
-	if (canAddToQueue()) {
-		if (m_bInvalidate && pSubPic->GetStop() > m_rtInvalidate) {
+	lock.lock();
+	m_rtUploadingStop = -1;
+	m_freeStatics.push_back(job.iStatic);
+	m_nPendingUploads--;
+
+	bool bAdded = false;
+	if (bCopied) {
+		if (job.nInvalidate != m_nInvalidate && pSubPic->GetStop() > m_rtInvalidate) {
 #if SUBPIC_TRACE_LEVEL > 1
-			DLog(L"Subtitle Renderer Thread: Dropping rendered subpic because of invalidation");
+			DLog(L"Subtitle Upload: Dropping rendered subpic because of invalidation");
 #endif
 		} else {
 			m_queue.AddTail(pSubPic);
-			lock.unlock();
-			m_condQueueReady.notify_one();
 			bAdded = true;
 		}
-		pSubPic.Release();
 	}
 
-	return bAdded;
+	lock.unlock();
+	if (bAdded) {
+		m_condQueueReady.notify_one();
+	}
+	m_condQueueFull.notify_one(); // a static subpic is available again
+	lock.lock();
 }
 
-REFERENCE_TIME CSubPicQueue::GetCurrentRenderingTime()
+void CSubPicQueue::UploadThreadProc()
 {
-	REFERENCE_TIME rtNow = -1;
+	SetThreadName(DWORD(-1), "Subtitle Upload Thread");
 
-	{
-		std::lock_guard<std::mutex> lock(m_mutexQueue);
-
-		if (!m_queue.IsEmpty()) {
-			rtNow = m_queue.GetTail()->GetStop();
+	std::unique_lock<std::mutex> lock(m_mutexQueue);
+	for (;;) {
+		m_condUpload.wait(lock, [this]() { return m_bExitThread || !m_uploadJobs.empty(); });
+		if (m_bExitThread) {
+			break;
 		}
-	}
 
-	return std::max(rtNow, m_rtNow);
+		UploadJob job = m_uploadJobs.front();
+		m_uploadJobs.pop_front();
+		UploadSubPic(job, lock);
+	}
 }
 
 // overrides
@@ -519,8 +584,12 @@ DWORD CSubPicQueue::ThreadProc()
 			auto& pSubPicProvider = pSubPicProviderWithSharedLock->pSubPicProvider;
 			double fps = m_fps;
 			REFERENCE_TIME rtTimePerFrame = m_rtTimePerFrame;
-			m_bInvalidate = false;
-			CComPtr<ISubPic> pSubPic;
+			unsigned nInvalidate;
+			{
+				std::lock_guard<std::mutex> lock(m_mutexQueue);
+				nInvalidate = m_nInvalidate;
+			}
+			bool bWaitForRoom = false;
 
 			SUBTITLE_TYPE sType = pSubPicProvider->GetType();
 
@@ -553,22 +622,47 @@ DWORD CSubPicQueue::ThreadProc()
 				// Check that we aren't late already...
 				if (rtCurrent < rtStop) {
 					bool bIsAnimated = pSubPicProvider->IsAnimated(pos) && !bDisableAnim;
-					bool bStopRendering = false;
 
 					while (rtCurrent < rtStop) {
-						SIZE	maxTextureSize, virtualSize;
-						POINT   virtualTopLeft;
+						SIZE	maxTextureSize, virtualSize = {};
+						POINT   virtualTopLeft = {};
 						HRESULT hr2;
 
 						if (SUCCEEDED(hr2 = pSubPicProvider->GetTextureSize(pos, maxTextureSize, virtualSize, virtualTopLeft))) {
 							m_pAllocator->SetMaxTextureSize(maxTextureSize);
 						}
 
+						int iStatic;
+						{
+							std::lock_guard<std::mutex> lock(m_mutexQueue);
+							if (!CanRenderSubPic()) {
+								// the queue is full, stop rendering
+								bWaitForRoom = true;
+								break;
+							}
+							iStatic = m_freeStatics.front();
+							m_freeStatics.pop_front();
+						}
+
+						auto releaseStatic = [&]() {
+							std::lock_guard<std::mutex> lock(m_mutexQueue);
+							m_freeStatics.push_front(iStatic);
+						};
+
 						CComPtr<ISubPic> pStatic;
-						if (FAILED(m_pAllocator->GetStatic(&pStatic))) {
+						if (FAILED(m_pAllocatorEx ? m_pAllocatorEx->GetStaticEx(iStatic, &pStatic) : m_pAllocator->GetStatic(&pStatic))) {
+							if (iStatic > 0) {
+								// no memory for a second static subpic, continue with the first one only
+								continue;
+							}
+							releaseStatic();
 							break;
 						}
 
+						if (iStatic > 0 && !m_uploadThread.joinable()) {
+							m_uploadThread = std::thread([this] { UploadThreadProc(); });
+						}
+
 						REFERENCE_TIME rtStopReal;
 						if (rtStop == ISubPicProvider::UNKNOWN_TIME) { // Special case for subtitles with unknown end time
 							// Force a one frame duration
@@ -600,6 +694,7 @@ DWORD CSubPicQueue::ThreadProc()
 						}
 
 						if (FAILED(hr)) {
+							releaseStatic();
 							break;
 						}
 
@@ -612,22 +707,19 @@ DWORD CSubPicQueue::ThreadProc()
 							  r.Width(), r.Height());
 #endif
 
-						pSubPic.Release();
-						if (FAILED(m_pAllocator->AllocDynamic(&pSubPic))
-								|| FAILED(pStatic->CopyTo(pSubPic))) {
-							break;
-						}
-
-						if (SUCCEEDED(hr2)) {
-							pSubPic->SetVirtualTextureSize(virtualSize, virtualTopLeft);
-						}
-
-						pSubPic->SetType(sType);
-
-						// Try to enqueue the subpic, if the queue is full stop rendering
-						if (!EnqueueSubPic(pSubPic, false)) {
-							bStopRendering = true;
-							break;
+						{
+							std::unique_lock<std::mutex> lock(m_mutexQueue);
+							m_rtPendingStop = pStatic->GetStop();
+							m_nPendingUploads++;
+							UploadJob job = { iStatic, pStatic, hr2, virtualSize, virtualTopLeft, sType, nInvalidate };
+							pStatic.Release();
+							if (m_uploadThread.joinable()) {
+								m_uploadJobs.push_back(std::move(job));
+								lock.unlock();
+								m_condUpload.notify_one();
+							} else {
+								UploadSubPic(job, lock);
+							}
 						}
 
 						if (m_rtNow > rtCurrent) {
@@ -638,7 +730,7 @@ DWORD CSubPicQueue::ThreadProc()
 						}
 					}
 
-					if (bStopRendering) {
+					if (bWaitForRoom) {
 						break;
 					}
 				} else {
@@ -650,10 +742,11 @@ DWORD CSubPicQueue::ThreadProc()
 
 			pSubPicProviderWithSharedLock->Unlock();
 
-			// If we couldn't enqueue the subpic before, wait for some room in the queue
+			// If the queue is full, wait for some room in the queue
 			// but unsure to unlock the subpicture provider first to avoid deadlocks
-			if (pSubPic) {
-				EnqueueSubPic(pSubPic, true);
+			if (bWaitForRoom) {
+				std::unique_lock<std::mutex> lock(m_mutexQueue);
+				m_condQueueFull.wait(lock, [this]() { return m_bExitThread || CanRenderSubPic(); });
 			}
 		} else {
 			bWaitForEvent = true;
@@ -25,6 +25,8 @@
 #include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <deque>
 
 #include "ISubPic.h"
 
@@ -146,12 +148,40 @@ protected:
 
 	REFERENCE_TIME m_rtNowLast = LONGLONG_ERROR;
 
-	bool m_bInvalidate = false;
+	unsigned m_nInvalidate = 0; // incremented by each Invalidate()
 	REFERENCE_TIME m_rtInvalidate = 0;
 
-	bool EnqueueSubPic(CComPtr<ISubPic>& pSubPic, bool bBlocking);
+	// The subtitles are rendered by ThreadProc() into the static subpics of the allocator,
+	// the upload thread copies them to dynamic subpics and adds them to the queue in order.
+	// The rendering of the next subpic runs while the previous one is being copied.
+	// The upload thread is started once a second static subpic has been allocated,
+	// with a single static subpic ThreadProc() copies the subpic itself.
+	struct UploadJob {
+		int iStatic;
+		CComPtr<ISubPic> pStatic;
+		HRESULT hrTextureSize;
+		SIZE virtualSize;
+		POINT virtualTopLeft;
+		SUBTITLE_TYPE sType;
+		unsigned nInvalidate;
+	};
+
+	CComQIPtr<ISubPicAllocatorEx> m_pAllocatorEx;
+	std::thread m_uploadThread;
+	std::condition_variable m_condUpload;
+	// protected by m_mutexQueue
+	std::deque<UploadJob> m_uploadJobs;
+	std::deque<int> m_freeStatics;
+	int m_nPendingUploads = 0;  // the jobs in m_uploadJobs and the one being copied
+	REFERENCE_TIME m_rtPendingStop = -1;   // stop time of the last pending job
+	REFERENCE_TIME m_rtUploadingStop = -1; // stop time of the job being copied
+
+	bool CanRenderSubPic() const; // must be called with m_mutexQueue locked
 	REFERENCE_TIME GetCurrentRenderingTime();
 
+	void UploadSubPic(UploadJob& job, std::unique_lock<std::mutex>& lock); // m_mutexQueue is locked on entry and on return
+	void UploadThreadProc();
+
 	// CAMThread
 	virtual DWORD ThreadProc();
 
@@ -21,6 +21,7 @@
 
 #include "stdafx.h"
 #include <intrin.h>
+#include <unordered_set>
 #include "RTS.h"
 
 // WARNING: this isn't very thread safe, use only one RTS a time. We should use TLS in future.
@@ -127,7 +128,18 @@ void CWord::Paint(const CPoint& p, const CPoint& org)
 
 	COverlayKey overlayKey(this, p, org);
 
-	if (m_renderingCaches.overlayCache.Lookup(overlayKey, m_pOverlayData)) {
+	if (m_pOverlayKey && m_pOverlayData && *m_pOverlayKey == overlayKey) {
+		// same geometry as the last paint of this word or of its previous instance,
+		// only the colors may differ and they are applied in Draw()
+		if (m_style.borderStyle == 1) {
+			if (m_style.outlineWidthX > 0.0 || m_style.shadowDepthX > 0.0 || m_style.outlineWidthY > 0.0 || m_style.shadowDepthY > 0.0) {
+				if (!CreateOpaqueBox()) {
+					return;
+				}
+			}
+		}
+	} else if (m_renderingCaches.overlayCache.Lookup(overlayKey, m_pOverlayData)) {
+		m_pOverlayKey = std::make_shared<COverlayKey>(overlayKey);
 		m_fDrawn = m_renderingCaches.outlineCache.Lookup(overlayKey, m_pOutlineData);
 		if (m_style.borderStyle == 1) {
 			if (m_style.outlineWidthX > 0.0 || m_style.shadowDepthX > 0.0 || m_style.outlineWidthY > 0.0 || m_style.shadowDepthY > 0.0) {
@@ -187,12 +199,18 @@ void CWord::Paint(const CPoint& p, const CPoint& org)
 			m_fDrawn = true;
 
 			if (!Rasterize(p.x & 7, p.y & 7, m_style.fBlur, m_style.fGaussianBlur)) {
+				m_pOverlayKey.reset();
 				return;
 			}
 			m_renderingCaches.overlayCache.SetAt(overlayKey, m_pOverlayData);
+			m_pOverlayKey = std::make_shared<COverlayKey>(overlayKey);
 		} else if ((m_p.x & 7) != (p.x & 7) || (m_p.y & 7) != (p.y & 7)) {
-			Rasterize(p.x & 7, p.y & 7, m_style.fBlur, m_style.fGaussianBlur);
+			if (!Rasterize(p.x & 7, p.y & 7, m_style.fBlur, m_style.fGaussianBlur)) {
+				m_pOverlayKey.reset();
+				return;
+			}
 			m_renderingCaches.overlayCache.SetAt(overlayKey, m_pOverlayData);
+			m_pOverlayKey = std::make_shared<COverlayKey>(overlayKey);
 		}
 	}
 
@@ -203,6 +221,18 @@ void CWord::Paint(const CPoint& p, const CPoint& org)
 	}
 }
 
+void CWord::InheritOverlay(CWord& w)
+{
+	if (!w.m_pOverlayKey || m_str != w.m_str) {
+		return;
+	}
+
+	// Paint() compares the key, a word that changed its geometry is rasterized again
+	m_pOverlayKey  = w.m_pOverlayKey;
+	m_pOverlayData = w.m_pOverlayData;
+	m_pOutlineData = w.m_pOutlineData;
+}
+
 bool CWord::CreateOpaqueBox()
 {
 	if (m_pOpaqueBox) {
@@ -287,6 +317,11 @@ void CWord::Transform(const CPoint &org ) // Transform_C
 #else
 void CWord::Transform(const CPoint &org ) // Transform_SSE2
 {
+	if (m_bUseAVX2) {
+		Transform_AVX2(org);
+		return;
+	}
+
 	// SSE2 code
 	// speed up ~1.5-1.7x
 	const __m128 __xshift = _mm_set_ps1((float)m_style.fontShiftX);
@@ -425,6 +460,93 @@ void CWord::Transform(const CPoint &org ) // Transform_SSE2
 		}
 	}
 }
+
+void CWord::Transform_AVX2(const CPoint &org)
+{
+	// AVX2 code
+	// the same float math as Transform_SSE2 on 8 points at a time, the results are identical
+	const __m256 __xshift = _mm256_set1_ps((float)m_style.fontShiftX);
+	const __m256 __yshift = _mm256_set1_ps((float)m_style.fontShiftY);
+
+	const __m256 __xorg = _mm256_set1_ps((float)org.x);
+	const __m256 __yorg = _mm256_set1_ps((float)org.y);
+
+	const __m256 __xscale = _mm256_set1_ps((float)(m_style.fontScaleX / 100.0));
+	const __m256 __yscale = _mm256_set1_ps((float)(m_style.fontScaleY / 100.0));
+	const __m256 __xzoomf = _mm256_set1_ps((float)(m_scalex * 20000.0));
+	const __m256 __yzoomf = _mm256_set1_ps((float)(m_scaley * 20000.0));
+
+	const __m256 __caz = _mm256_set1_ps((float)cos((M_PI / 180.0) * m_style.fontAngleZ));
+	const __m256 __saz = _mm256_set1_ps((float)sin((M_PI / 180.0) * m_style.fontAngleZ));
+	const __m256 __cax = _mm256_set1_ps((float)cos((M_PI / 180.0) * m_style.fontAngleX));
+	const __m256 __sax = _mm256_set1_ps((float)sin((M_PI / 180.0) * m_style.fontAngleX));
+	const __m256 __cay = _mm256_set1_ps((float)cos((M_PI / 180.0) * m_style.fontAngleY));
+	const __m256 __say = _mm256_set1_ps((float)sin((M_PI / 180.0) * m_style.fontAngleY));
+
+	const __m256 __1000 = _mm256_set1_ps(1000.0f);
+
+	const bool bShiftX = m_style.fontShiftX != 0;
+	const bool bShiftY = m_style.fontShiftY != 0;
+
+	// x0 y0 x1 y1 x2 y2 x3 y3 <-> x0 x1 x2 x3 y0 y1 y2 y3
+	const __m256i __deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	const __m256i __interleave   = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	auto Transform8 = [&](POINT* points) {
+		// split 8 POINTs into x and y vectors
+		const __m256i __lo = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)points), __deinterleave);
+		const __m256i __hi = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(points + 4)), __deinterleave);
+		__m256 __pointx = _mm256_cvtepi32_ps(_mm256_permute2x128_si256(__lo, __hi, 0x20));
+		__m256 __pointy = _mm256_cvtepi32_ps(_mm256_permute2x128_si256(__lo, __hi, 0x31));
+
+		// scale and shift
+		const __m256 __srcx = __pointx;
+		if (bShiftX) {
+			__pointx = _mm256_add_ps(__pointx, _mm256_mul_ps(__xshift, __pointy));
+		}
+		__pointx = _mm256_sub_ps(_mm256_mul_ps(__pointx, __xscale), __xorg);
+
+		if (bShiftY) {
+			__pointy = _mm256_add_ps(__pointy, _mm256_mul_ps(__yshift, __srcx));
+		}
+		__pointy = _mm256_sub_ps(_mm256_mul_ps(__pointy, __yscale), __yorg);
+
+		// rotate, the initial z is 0
+		const __m256 __x  = _mm256_add_ps(_mm256_mul_ps(__pointx, __caz), _mm256_mul_ps(__pointy, __saz)); // x = x * caz + y * saz
+		const __m256 __yy = _mm256_sub_ps(_mm256_mul_ps(__pointy, __caz), _mm256_mul_ps(__pointx, __saz)); // yy = y * caz - x * saz
+		const __m256 __y  = _mm256_mul_ps(__yy, __cax);                                                     // y = yy * cax
+		const __m256 __z  = _mm256_mul_ps(__yy, __sax);                                                     // z = yy * sax
+		const __m256 __xx = _mm256_add_ps(_mm256_mul_ps(__x, __cay), _mm256_mul_ps(__z, __say));           // xx = x * cay + z * say
+		const __m256 __zz = _mm256_sub_ps(_mm256_mul_ps(__x, __say), _mm256_mul_ps(__z, __cay));           // zz = x * say - z * cay
+
+		// x = xx * xzoomf / std::max((zz + xzoomf), 1000.0) + org.x;
+		// y = y * yzoomf / std::max((zz + yzoomf), 1000.0) + org.y;
+		__pointx = _mm256_div_ps(_mm256_mul_ps(__xx, __xzoomf), _mm256_max_ps(_mm256_add_ps(__zz, __xzoomf), __1000));
+		__pointy = _mm256_div_ps(_mm256_mul_ps(__y, __yzoomf), _mm256_max_ps(_mm256_add_ps(__zz, __yzoomf), __1000));
+		__pointx = _mm256_add_ps(__pointx, __xorg);
+		__pointy = _mm256_add_ps(__pointy, __yorg);
+
+		// round to integer and merge back into POINTs
+		const __m256i __xi = _mm256_cvtps_epi32(__pointx);
+		const __m256i __yi = _mm256_cvtps_epi32(__pointy);
+		_mm256_storeu_si256((__m256i*)points, _mm256_permutevar8x32_epi32(_mm256_permute2x128_si256(__xi, __yi, 0x20), __interleave));
+		_mm256_storeu_si256((__m256i*)(points + 4), _mm256_permutevar8x32_epi32(_mm256_permute2x128_si256(__xi, __yi, 0x31), __interleave));
+	};
+
+	const int mPathPointsA8 = mPathPoints & ~7;
+	for (int i = 0; i < mPathPointsA8; i += 8) {
+		Transform8(mpPathPoints + i);
+	}
+
+	if (const int rest = mPathPoints - mPathPointsA8) {
+		POINT tail[8] = {};
+		memcpy(tail, mpPathPoints + mPathPointsA8, rest * sizeof(POINT));
+		Transform8(tail);
+		memcpy(mpPathPoints + mPathPointsA8, tail, rest * sizeof(POINT));
+	}
+
+	_mm256_zeroupper();
+}
 #endif
 
 // CText
@@ -845,7 +967,10 @@ CAlphaMaskSharedPtr CClipper::GetAlphaMask(const std::shared_ptr<CClipper>& clip
 		return NULL;
 	}
 
-	const size_t alphaMaskSize = size_t(m_size.cx) * m_size.cy;
+	// Only the bounding box of the clip is stored, the area outside of it is handled analytically.
+	// The effects fade the whole frame, so they keep a full frame mask.
+	const CRect rcMask = (m_effectType == -1) ? CRect(x, y, x + w, y + h) : CRect(0, 0, m_size.cx, m_size.cy);
+	const size_t alphaMaskSize = size_t(rcMask.Width()) * rcMask.Height();
 
 	try {
 		m_pAlphaMask = CAlphaMask::Alloc(m_renderingCaches.alphaMaskPool, alphaMaskSize);
@@ -854,27 +979,31 @@ CAlphaMaskSharedPtr CClipper::GetAlphaMask(const std::shared_ptr<CClipper>& clip
 		m_pAlphaMask = NULL;
 		return NULL;
 	}
+	m_pAlphaMask->m_rect = rcMask;
+	m_pAlphaMask->m_inverse = m_inverse;
 
 	BYTE* pAlphaMask = m_pAlphaMask->get();
-	memset(pAlphaMask, (m_inverse ? 0x40 : 0), alphaMaskSize);
+	const int maskPitch = rcMask.Width();
+	if (rcMask.Width() != w || rcMask.Height() != h) {
+		memset(pAlphaMask, (m_inverse ? 0x40 : 0), alphaMaskSize);
+	}
 
 	const BYTE* src = m_pOverlayData->mpOverlayBufferBody + m_pOverlayData->mOverlayPitch * yo + xo;
-	BYTE* dst = pAlphaMask + m_size.cx * y + x;
+	BYTE* dst = pAlphaMask + maskPitch * (y - rcMask.top) + (x - rcMask.left);
 
-	memset(pAlphaMask, (m_inverse ? 0x40 : 0), m_size.cx * y + x);
 	if (m_inverse) {
 		for (ptrdiff_t i = 0; i < h; ++i) {
 			for (ptrdiff_t wt = 0; wt < w; ++wt) {
 				dst[wt] = 0x40 - src[wt];
 			}
 			src += m_pOverlayData->mOverlayPitch;
-			dst += m_size.cx;
+			dst += maskPitch;
 		}
 	} else {
 		for (ptrdiff_t i = 0; i < h; ++i) {
 			memcpy(dst, src, w * sizeof(BYTE));
 			src += m_pOverlayData->mOverlayPitch;
-			dst += m_size.cx;
+			dst += maskPitch;
 		}
 	}
 
@@ -1047,7 +1176,7 @@ void CLine::Compact()
 	}
 }
 
-CRect CLine::PaintShadow(SubPicDesc& spd, CRect& clipRect, BYTE* pAlphaMask, CPoint p, CPoint org, int time, int alpha)
+CRect CLine::PaintShadow(SubPicDesc& spd, CRect& clipRect, const CAlphaMaskRect* pAlphaMask, CPoint p, CPoint org, int time, int alpha)
 {
 	CRect bbox(0, 0, 0, 0);
 
@@ -1087,7 +1216,7 @@ CRect CLine::PaintShadow(SubPicDesc& spd, CRect& clipRect, BYTE* pAlphaMask, CPo
 	return bbox;
 }
 
-CRect CLine::PaintOutline(SubPicDesc& spd, CRect& clipRect, BYTE* pAlphaMask, CPoint p, CPoint org, int time, int alpha)
+CRect CLine::PaintOutline(SubPicDesc& spd, CRect& clipRect, const CAlphaMaskRect* pAlphaMask, CPoint p, CPoint org, int time, int alpha)
 {
 	CRect bbox(0, 0, 0, 0);
 
@@ -1125,7 +1254,7 @@ CRect CLine::PaintOutline(SubPicDesc& spd, CRect& clipRect, BYTE* pAlphaMask, CP
 	return bbox;
 }
 
-CRect CLine::PaintBody(SubPicDesc& spd, CRect& clipRect, BYTE* pAlphaMask, CPoint p, CPoint org, int time, int alpha)
+CRect CLine::PaintBody(SubPicDesc& spd, CRect& clipRect, const CAlphaMaskRect* pAlphaMask, CPoint p, CPoint org, int time, int alpha)
 {
 	CRect bbox(0, 0, 0, 0);
 
@@ -1474,34 +1603,57 @@ void CSubtitle::MakeLines(CSize size, const CRect& marginRect)
 				 spaceNeeded);
 }
 
+// Takes the rasterized words of the previous instance of an animated subtitle, the words
+// are paired by their position in the lines. Karaoke, color and alpha animations don't
+// change the geometry, so these words are not rasterized again every frame.
+void CSubtitle::InheritOverlays(CSubtitle& sub)
+{
+	POSITION pos = GetHeadPosition();
+	POSITION posPrev = sub.GetHeadPosition();
+	while (pos && posPrev) {
+		CLine* l = GetNext(pos);
+		CLine* lPrev = sub.GetNext(posPrev);
+
+		POSITION wpos = l->GetHeadPosition();
+		POSITION wposPrev = lPrev->GetHeadPosition();
+		while (wpos && wposPrev) {
+			l->GetNext(wpos)->InheritOverlay(*lPrev->GetNext(wposPrev));
+		}
+	}
+}
+
 // CScreenLayoutAllocator
 
 void CScreenLayoutAllocator::Empty()
 {
-	m_subrects.RemoveAll();
+	m_layers.clear();
+	m_index.clear();
 }
 
 void CScreenLayoutAllocator::AdvanceToSegment(int segment, const CAtlArray<int>& sa)
 {
-	POSITION pos = m_subrects.GetHeadPosition();
-	while (pos) {
-		POSITION prev = pos;
+	const std::unordered_set<int> entries(sa.GetData(), sa.GetData() + sa.GetCount());
 
-		SubRect& sr = m_subrects.GetNext(pos);
+	m_index.clear();
 
-		bool fFound = false;
+	for (auto it = m_layers.begin(); it != m_layers.end();) {
+		auto& rects = it->second;
 
-		if (abs(sr.segment - segment) <= 1) { // using abs() makes it possible to play the subs backwards, too :)
-			for (size_t i = 0; i < sa.GetCount() && !fFound; i++) {
-				if (sa[i] == sr.entry) {
-					sr.segment = segment;
-					fFound = true;
-				}
+		size_t n = 0;
+		for (auto& sr : rects) {
+			// using abs() makes it possible to play the subs backwards, too :)
+			if (abs(sr.segment - segment) <= 1 && entries.count(sr.entry)) {
+				sr.segment = segment;
+				m_index.emplace(IndexKey(sr.segment, sr.entry), sr.r);
+				rects[n++] = sr;
 			}
 		}
+		rects.resize(n);
 
-		if (!fFound) {
-			m_subrects.RemoveAt(prev);
+		if (rects.empty()) {
+			it = m_layers.erase(it);
+		} else {
+			++it;
 		}
 	}
 }
@@ -1510,49 +1662,58 @@ CRect CScreenLayoutAllocator::AllocRect(const CSubtitle* s, int segment, int ent
 {
 	// TODO: handle collisions == 1 (reversed collisions)
 
-	POSITION pos = m_subrects.GetHeadPosition();
-	while (pos) {
-		SubRect& sr = m_subrects.GetNext(pos);
-		if (sr.segment == segment && sr.entry == entry) {
-			return (sr.r + CRect(0, -s->m_topborder, 0, -s->m_bottomborder));
-		}
+	const auto it = m_index.find(IndexKey(segment, entry));
+	if (it != m_index.end()) {
+		return (it->second + CRect(0, -s->m_topborder, 0, -s->m_bottomborder));
 	}
 
 	CRect r = s->m_rect + CRect(0, s->m_topborder, 0, s->m_bottomborder);
 
 	bool fSearchDown = s->m_scrAlignment > 3;
 
+	auto& rects = m_layers[layer];
+
+	// The rect only moves vertically and always in the same direction. The rects without a
+	// horizontal overlap never collide, the ones it has moved past can't collide anymore.
+	// The remaining ones are tested in allocation order as before, so the placement is the same.
+	std::vector<const CRect*> candidates;
+	candidates.reserve(rects.size());
+	for (const auto& sr : rects) {
+		if (sr.r.left < r.right && r.left < sr.r.right) {
+			candidates.emplace_back(&sr.r);
+		}
+	}
+
 	bool fOK;
 
 	do {
 		fOK = true;
 
-		pos = m_subrects.GetHeadPosition();
-		while (pos) {
-			SubRect& sr = m_subrects.GetNext(pos);
-
-			if (layer == sr.layer && !(r & sr.r).IsRectEmpty()) {
+		for (const CRect* pr : candidates) {
+			if (!(r & *pr).IsRectEmpty()) {
 				if (fSearchDown) {
-					r.bottom = sr.r.bottom + r.Height();
-					r.top = sr.r.bottom;
+					r.bottom = pr->bottom + r.Height();
+					r.top = pr->bottom;
 				} else {
-					r.top = sr.r.top - r.Height();
-					r.bottom = sr.r.top;
+					r.top = pr->top - r.Height();
+					r.bottom = pr->top;
 				}
 
 				fOK = false;
 			}
 		}
+
+		if (!fOK) {
+			candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const CRect* pr) {
+				return fSearchDown ? pr->bottom <= r.top : pr->top >= r.bottom;
+			}), candidates.end());
+		}
 	} while (!fOK);
 
-	SubRect sr;
-	sr.r = r;
-	sr.segment = segment;
-	sr.entry = entry;
-	sr.layer = layer;
-	m_subrects.AddTail(sr);
+	rects.push_back({ r, segment, entry });
+	m_index.emplace(IndexKey(segment, entry), r);
 
-	return (sr.r + CRect(0, -s->m_topborder, 0, -s->m_bottomborder));
+	return (r + CRect(0, -s->m_topborder, 0, -s->m_bottomborder));
 }
 
 // CRenderedTextSubtitle
@@ -1574,6 +1735,7 @@ CRenderedTextSubtitle::CRenderedTextSubtitle(CCritSec* pLock)
 	, m_kend(0)
 	, m_nPolygon(0)
 	, m_polygonBaselineOffset(0)
+	, m_compiledEntries(2048)
 {
 	m_size = CSize(0, 0);
 
@@ -1669,6 +1831,8 @@ void CRenderedTextSubtitle::Empty()
 {
 	Deinit();
 
+	m_compiledEntries.Clear();
+
 	__super::Empty();
 }
 
@@ -1687,6 +1851,8 @@ void CRenderedTextSubtitle::OnChanged()
 	m_subtitleCache.RemoveAll();
 
 	m_sla.Empty();
+
+	m_compiledEntries.Clear();
 }
 
 bool CRenderedTextSubtitle::Init(CSize size, const CRect& vidrect)
@@ -1844,6 +2010,30 @@ void CRenderedTextSubtitle::ParsePolygon(CSubtitle* sub, CStringW str, STSStyle&
 	}
 }
 
+#ifdef DEBUG_OR_LOG
+// approximate memory used by a parsed override block
+static size_t GetSSATagsListSize(const SSATagsList& tagsList)
+{
+	if (!tagsList) {
+		return 0;
+	}
+
+	size_t size = sizeof(CAtlList<SSATag>);
+	POSITION pos = tagsList->GetHeadPosition();
+	while (pos) {
+		const SSATag& tag = tagsList->GetNext(pos);
+		size += sizeof(SSATag) + 2 * sizeof(void*); // list node
+		for (size_t i = 0; i < tag.params.GetCount(); i++) {
+			size += sizeof(CStringW) + sizeof(CStringData) + (tag.params[i].GetLength() + 1) * sizeof(WCHAR);
+		}
+		size += tag.paramsInt.GetCount() * sizeof(int) + tag.paramsReal.GetCount() * sizeof(double);
+		size += GetSSATagsListSize(tag.subTagsList);
+	}
+
+	return size;
+}
+#endif
+
 bool CRenderedTextSubtitle::ParseSSATag(SSATagsList& tagsList, const CStringW& str)
 {
 	if (m_renderingCaches.SSATagsCache.Lookup(str, tagsList)) {
@@ -2653,9 +2843,10 @@ double CRenderedTextSubtitle::CalcAnimation(double dst, double src, bool fAnimat
 CSubtitle* CRenderedTextSubtitle::GetSubtitle(int entry)
 {
 	CSubtitle* sub;
+	std::unique_ptr<CSubtitle> pPrevSub;
 	if (m_subtitleCache.Lookup(entry, sub)) {
 		if (sub->m_fAnimated) {
-			delete sub;
+			pPrevSub.reset(sub);
 			sub = NULL;
 		} else {
 			return sub;
@@ -2670,6 +2861,17 @@ CSubtitle* CRenderedTextSubtitle::GetSubtitle(int entry)
 	}
 
 	CStringW str = GetStrW(entry, true);
+	const int length = str.GetLength();
+	const ULONG hash = CStringElementTraits<CStringW>::Hash(str);
+
+	CompiledEntrySharedPtr pCompiled;
+	const bool bCompiled = m_compiledEntries.Lookup(entry, pCompiled) && pCompiled->hash == hash && pCompiled->length == length;
+	if (!bCompiled) {
+		pCompiled = std::make_shared<CompiledEntry>();
+		pCompiled->hash = hash;
+		pCompiled->length = length;
+	}
+	LONGLONG compileTime = 0;
 
 	STSStyle stss;
 	if (m_bOverrideStyle) {
@@ -2797,7 +2999,25 @@ CSubtitle* CRenderedTextSubtitle::GetSubtitle(int entry)
 
 		if (str[0] == '{' && (i = str.Find(L'}')) > 0) {
 			SSATagsList tagsList;
-			bParsed = ParseSSATag(tagsList, str.Mid(1, i - 1));
+			const int pos = length - str.GetLength();
+			if (bCompiled) {
+				const auto it = std::lower_bound(pCompiled->blocks.cbegin(), pCompiled->blocks.cend(), pos, [](const auto& block, int p) {
+					return block.first < p;
+				});
+				if (it != pCompiled->blocks.cend() && it->first == pos) {
+					tagsList = it->second;
+				}
+			}
+			if (tagsList) {
+				bParsed = true;
+			} else {
+				const auto start = GetPerfCounter();
+				bParsed = ParseSSATag(tagsList, str.Mid(1, i - 1));
+				compileTime += GetPerfCounter() - start;
+				if (bParsed && !bCompiled) {
+					pCompiled->blocks.emplace_back(pos, tagsList);
+				}
+			}
 			if (bParsed) {
 				CreateSubFromSSATag(sub, tagsList, stss, orgstss, m_bOverrideStyle);
 				str = str.Mid(i+1);
@@ -2871,10 +3091,25 @@ CSubtitle* CRenderedTextSubtitle::GetSubtitle(int entry)
 
 	sub->m_scrAlignment = abs(sub->m_scrAlignment);
 
+	if (!bCompiled) {
+		m_compiledEntries.SetAt(entry, pCompiled);
+#ifdef DEBUG_OR_LOG
+		size_t size = sizeof(CompiledEntry) + pCompiled->blocks.capacity() * sizeof(pCompiled->blocks[0]);
+		for (const auto& block : pCompiled->blocks) {
+			size += GetSSATagsListSize(block.second);
+		}
+		DLog(L"CRenderedTextSubtitle::GetSubtitle() : entry %d, %Iu override blocks parsed in %.3f ms, ~%Iu bytes", entry, pCompiled->blocks.size(), compileTime / 10000.0, size);
+#endif
+	}
+
 	sub->CreateClippers(m_size);
 
 	sub->MakeLines(m_size, marginRect);
 
+	if (pPrevSub) {
+		sub->InheritOverlays(*pPrevSub);
+	}
+
 	m_subtitleCache[entry] = sub;
 
 	return sub;
@@ -3096,7 +3331,6 @@ STDMETHODIMP CRenderedTextSubtitle::Render(SubPicDesc& spd, REFERENCE_TIME rt, d
 		CPoint org2;
 
 		const auto& ptrAlphaMask = s->m_pClipper ? s->m_pClipper->GetAlphaMask(s->m_pClipper) : NULL;
-		BYTE* pAlphaMask = ptrAlphaMask ? ptrAlphaMask->get() : NULL;
 
 		for (int k = 0; k < EF_NUMBEROFEFFECTS; k++) {
 			if (!s->m_effects[k]) {
@@ -3238,6 +3472,47 @@ STDMETHODIMP CRenderedTextSubtitle::Render(SubPicDesc& spd, REFERENCE_TIME rt, d
 		iclipRect[2] = CRect(clipRect.right, clipRect.top, spd.w, clipRect.bottom);
 		iclipRect[3] = CRect(0, clipRect.bottom, spd.w, spd.h);
 
+		// Rectangles to paint, each with or without the alpha mask. The mask only covers
+		// the bounding box of a vector clip, outside of it nothing is painted for \clip
+		// and everything is painted unmasked for \iclip.
+		const CAlphaMaskRect alphaMask = ptrAlphaMask ? CAlphaMaskRect{ ptrAlphaMask->get(), ptrAlphaMask->m_rect } : CAlphaMaskRect{};
+		std::vector<std::pair<CRect, const CAlphaMaskRect*>> paintRects;
+		auto addPaintRect = [&](const CRect& rect) {
+			if (rect.IsRectEmpty()) {
+				return;
+			}
+			if (!ptrAlphaMask) {
+				paintRects.emplace_back(rect, nullptr);
+				return;
+			}
+
+			const CRect& m = alphaMask.rect;
+			const CRect rcMasked = rect & m;
+			if (!rcMasked.IsRectEmpty()) {
+				paintRects.emplace_back(rcMasked, &alphaMask);
+			}
+			if (ptrAlphaMask->m_inverse) {
+				const CRect rcOutside[4] = {
+					CRect(rect.left, rect.top, rect.right, std::min(rect.bottom, m.top)),
+					CRect(rect.left, std::max(rect.top, m.bottom), rect.right, rect.bottom),
+					CRect(rect.left, std::max(rect.top, m.top), std::min(rect.right, m.left), std::min(rect.bottom, m.bottom)),
+					CRect(std::max(rect.left, m.right), std::max(rect.top, m.top), rect.right, std::min(rect.bottom, m.bottom))
+				};
+				for (const auto& rc : rcOutside) {
+					if (!rc.IsRectEmpty()) {
+						paintRects.emplace_back(rc, nullptr);
+					}
+				}
+			}
+		};
+		if (s->m_clipInverse) {
+			for (const auto& rc : iclipRect) {
+				addPaintRect(rc);
+			}
+		} else {
+			addPaintRect(clipRect);
+		}
+
 		POSITION pos = s->GetHeadPosition();
 		while (pos) {
 			CLine* l = s->GetNext(pos);
@@ -3245,13 +3520,8 @@ STDMETHODIMP CRenderedTextSubtitle::Render(SubPicDesc& spd, REFERENCE_TIME rt, d
 			p.x = (s->m_scrAlignment % 3) == 1 ? org.x
 				: (s->m_scrAlignment % 3) == 0 ? org.x - l->m_width
 				:                                org.x - (l->m_width / 2);
-			if (s->m_clipInverse) {
-				bbox2 |= l->PaintShadow(spd, iclipRect[0], pAlphaMask, p, org2, m_time, alpha);
-				bbox2 |= l->PaintShadow(spd, iclipRect[1], pAlphaMask, p, org2, m_time, alpha);
-				bbox2 |= l->PaintShadow(spd, iclipRect[2], pAlphaMask, p, org2, m_time, alpha);
-				bbox2 |= l->PaintShadow(spd, iclipRect[3], pAlphaMask, p, org2, m_time, alpha);
-			} else {
-				bbox2 |= l->PaintShadow(spd, clipRect, pAlphaMask, p, org2, m_time, alpha);
+			for (auto& paintRect : paintRects) {
+				bbox2 |= l->PaintShadow(spd, paintRect.first, paintRect.second, p, org2, m_time, alpha);
 			}
 			p.y += l->m_ascent + l->m_descent;
 		}
@@ -3264,13 +3534,8 @@ STDMETHODIMP CRenderedTextSubtitle::Render(SubPicDesc& spd, REFERENCE_TIME rt, d
 			p.x = (s->m_scrAlignment % 3) == 1 ? org.x
 				: (s->m_scrAlignment % 3) == 0 ? org.x - l->m_width
 				:                                org.x - (l->m_width / 2);
-			if (s->m_clipInverse) {
-				bbox2 |= l->PaintOutline(spd, iclipRect[0], pAlphaMask, p, org2, m_time, alpha);
-				bbox2 |= l->PaintOutline(spd, iclipRect[1], pAlphaMask, p, org2, m_time, alpha);
-				bbox2 |= l->PaintOutline(spd, iclipRect[2], pAlphaMask, p, org2, m_time, alpha);
-				bbox2 |= l->PaintOutline(spd, iclipRect[3], pAlphaMask, p, org2, m_time, alpha);
-			} else {
-				bbox2 |= l->PaintOutline(spd, clipRect, pAlphaMask, p, org2, m_time, alpha);
+			for (auto& paintRect : paintRects) {
+				bbox2 |= l->PaintOutline(spd, paintRect.first, paintRect.second, p, org2, m_time, alpha);
 			}
 			p.y += l->m_ascent + l->m_descent;
 		}
@@ -3283,13 +3548,8 @@ STDMETHODIMP CRenderedTextSubtitle::Render(SubPicDesc& spd, REFERENCE_TIME rt, d
 			p.x = (s->m_scrAlignment % 3) == 1 ? org.x
 				: (s->m_scrAlignment % 3) == 0 ? org.x - l->m_width
 				:                                org.x - (l->m_width / 2);
-			if (s->m_clipInverse) {
-				bbox2 |= l->PaintBody(spd, iclipRect[0], pAlphaMask, p, org2, m_time, alpha);
-				bbox2 |= l->PaintBody(spd, iclipRect[1], pAlphaMask, p, org2, m_time, alpha);
-				bbox2 |= l->PaintBody(spd, iclipRect[2], pAlphaMask, p, org2, m_time, alpha);
-				bbox2 |= l->PaintBody(spd, iclipRect[3], pAlphaMask, p, org2, m_time, alpha);
-			} else {
-				bbox2 |= l->PaintBody(spd, clipRect, pAlphaMask, p, org2, m_time, alpha);
+			for (auto& paintRect : paintRects) {
+				bbox2 |= l->PaintBody(spd, paintRect.first, paintRect.second, p, org2, m_time, alpha);
 			}
 			p.y += l->m_ascent + l->m_descent;
 		}
@@ -21,7 +21,9 @@
 
 #pragma once
 
+#include <map>
 #include <mutex>
+#include <unordered_map>
 #include "STS.h"
 #include "Rasterizer.h"
 #include "SubPic/SubPicProviderImpl.h"
@@ -54,6 +56,9 @@ struct CAlphaMask final : std::unique_ptr<BYTE[]> {
 	CAlphaMask& operator=(const CAlphaMask&) = delete;
 
 	size_t m_size;
+	// the mask covers m_rect only, everything outside of it is clipped unless m_inverse is set
+	CRect m_rect;
+	bool m_inverse = false;
 
 	explicit CAlphaMask(size_t size)
 		: std::unique_ptr<BYTE[]>(std::make_unique<BYTE[]>(size))
@@ -61,13 +66,21 @@ struct CAlphaMask final : std::unique_ptr<BYTE[]> {
 	}
 
 	static std::shared_ptr<CAlphaMask> Alloc(std::list<CAlphaMask>& alphaMaskPool, size_t size) {
+		// the smallest pooled buffer that fits, a much larger one (e.g. a full frame mask
+		// asked for a small clip) is freed instead of being kept alive by the small mask
+		auto best = alphaMaskPool.end();
 		for (auto it = alphaMaskPool.begin(); it != alphaMaskPool.end(); ++it) {
-			auto& am = *it;
-			if (am.m_size >= size) {
-				auto ret = std::shared_ptr<CAlphaMask>(DEBUG_NEW CAlphaMask(std::move(am)), alpha_mask_deleter(alphaMaskPool));
-				alphaMaskPool.erase(it);
+			if (it->m_size >= size && (best == alphaMaskPool.end() || it->m_size < best->m_size)) {
+				best = it;
+			}
+		}
+		if (best != alphaMaskPool.end()) {
+			if (best->m_size / 4 <= size) {
+				auto ret = std::shared_ptr<CAlphaMask>(DEBUG_NEW CAlphaMask(std::move(*best)), alpha_mask_deleter(alphaMaskPool));
+				alphaMaskPool.erase(best);
 				return std::move(ret);
 			}
+			alphaMaskPool.erase(best);
 		}
 		return std::shared_ptr<CAlphaMask>(DEBUG_NEW CAlphaMask(size), alpha_mask_deleter(alphaMaskPool));
 	}
@@ -128,6 +141,7 @@ class CWord : public Rasterizer
 	CPoint m_p;
 
 	void Transform(const CPoint &org );
+	void Transform_AVX2(const CPoint &org);
 	bool CreateOpaqueBox();
 
 protected:
@@ -136,6 +150,9 @@ protected:
 	double m_scalex, m_scaley;
 	CStringW m_str;
 
+	// geometry m_pOverlayData was rasterized for, it can move to the next instance of an animated subtitle
+	std::shared_ptr<COverlayKey> m_pOverlayKey;
+
 	virtual bool CreatePath() PURE;
 
 public:
@@ -158,6 +175,7 @@ public:
 	virtual bool Append(CWord* w);
 
 	void Paint(const CPoint& p, const CPoint& org);
+	void InheritOverlay(CWord& w);
 
 	friend class COutlineKey;
 
@@ -285,9 +303,9 @@ public:
 
 	void Compact();
 
-	CRect PaintShadow(SubPicDesc& spd, CRect& clipRect, BYTE* pAlphaMask, CPoint p, CPoint org, int time, int alpha);
-	CRect PaintOutline(SubPicDesc& spd, CRect& clipRect, BYTE* pAlphaMask, CPoint p, CPoint org, int time, int alpha);
-	CRect PaintBody(SubPicDesc& spd, CRect& clipRect, BYTE* pAlphaMask, CPoint p, CPoint org, int time, int alpha);
+	CRect PaintShadow(SubPicDesc& spd, CRect& clipRect, const CAlphaMaskRect* pAlphaMask, CPoint p, CPoint org, int time, int alpha);
+	CRect PaintOutline(SubPicDesc& spd, CRect& clipRect, const CAlphaMaskRect* pAlphaMask, CPoint p, CPoint org, int time, int alpha);
+	CRect PaintBody(SubPicDesc& spd, CRect& clipRect, const CAlphaMaskRect* pAlphaMask, CPoint p, CPoint org, int time, int alpha);
 };
 
 enum SSATagCmd {
@@ -420,16 +438,24 @@ public:
 	void CreateClippers(CSize size);
 
 	void MakeLines(CSize size, const CRect& marginRect);
+	void InheritOverlays(CSubtitle& sub);
 };
 
 class CScreenLayoutAllocator
 {
 	struct SubRect {
 		CRect r;
-		int segment, entry, layer;
+		int segment, entry;
 	};
 
-	CAtlList<SubRect> m_subrects;
+	// allocated rects of each layer in allocation order, only the rects of the same layer collide
+	std::map<int, std::vector<SubRect>> m_layers;
+	// (segment, entry) -> allocated rect
+	std::unordered_map<uint64_t, CRect> m_index;
+
+	static uint64_t IndexKey(int segment, int entry) {
+		return ((uint64_t)(uint32_t)segment << 32) | (uint32_t)entry;
+	}
 
 public:
 	/*virtual*/
@@ -449,6 +475,16 @@ class __declspec(uuid("537DCACA-2812-4a4f-B2C6-1A34C17ADEB0"))
 
 	CScreenLayoutAllocator m_sla;
 
+	// override blocks of the recently built entries, parsed once per entry. Animated entries are built
+	// again on every frame. The tag lists are shared with SSATagsCache.
+	struct CompiledEntry {
+		ULONG hash = 0; // of the entry text, SetStr() changes an entry without OnChanged()
+		int length = 0;
+		std::vector<std::pair<int, SSATagsList>> blocks; // position of '{' in the text, parsed tags
+	};
+	typedef std::shared_ptr<CompiledEntry> CompiledEntrySharedPtr;
+	CRenderingCache<int, CompiledEntrySharedPtr> m_compiledEntries;
+
 	CSize m_size;
 	CRect m_vidrect;
 
@@ -771,6 +771,54 @@ void Rasterizer::CreateWidenedRegionFast(const int ry)
 	flushLines(yPrec - ry, yPrec + ry + 1, m_pOutlineData->mWideOutline);
 }
 
+// One pass of the \be blur: the 3x3 kernel [1 2 1] x [1 2 1] / 16, done separately on the rows
+// and on the columns. The sums fit in 16 bits, so the results are the same as the ones of the
+// direct 3x3 kernel. The border pixels are not changed. tmp has the pitch and height of buffer.
+static void BeBlurPass(byte* buffer, int width, int height, int pitch, uint16_t* tmp)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	for (int j = 0; j < height; j++) {
+		const byte* src = buffer + pitch * j;
+		uint16_t* dst = tmp + pitch * j;
+
+		int i = 1;
+		for (; i + 16 <= width - 1; i += 16) {
+			__m128i l = _mm_loadu_si128((const __m128i*)(src + i - 1));
+			__m128i c = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i r = _mm_loadu_si128((const __m128i*)(src + i + 1));
+			__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(l, zero), _mm_unpacklo_epi8(r, zero)),
+									   _mm_slli_epi16(_mm_unpacklo_epi8(c, zero), 1));
+			__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(l, zero), _mm_unpackhi_epi8(r, zero)),
+									   _mm_slli_epi16(_mm_unpackhi_epi8(c, zero), 1));
+			_mm_storeu_si128((__m128i*)(dst + i), lo);
+			_mm_storeu_si128((__m128i*)(dst + i + 8), hi);
+		}
+		for (; i < width - 1; i++) {
+			dst[i] = src[i - 1] + (src[i] << 1) + src[i + 1];
+		}
+	}
+
+	for (int j = 1; j < height - 1; j++) {
+		const uint16_t* src0 = tmp + pitch * (j - 1);
+		const uint16_t* src1 = src0 + pitch;
+		const uint16_t* src2 = src1 + pitch;
+		byte* dst = buffer + pitch * j;
+
+		int i = 1;
+		for (; i + 16 <= width - 1; i += 16) {
+			__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i*)(src0 + i)), _mm_loadu_si128((const __m128i*)(src2 + i))),
+									   _mm_slli_epi16(_mm_loadu_si128((const __m128i*)(src1 + i)), 1));
+			__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i*)(src0 + i + 8)), _mm_loadu_si128((const __m128i*)(src2 + i + 8))),
+									   _mm_slli_epi16(_mm_loadu_si128((const __m128i*)(src1 + i + 8)), 1));
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_srli_epi16(lo, 4), _mm_srli_epi16(hi, 4)));
+		}
+		for (; i < width - 1; i++) {
+			dst[i] = (src0[i] + (src1[i] << 1) + src2[i]) >> 4;
+		}
+	}
+}
+
 bool Rasterizer::Rasterize(int xsub, int ysub, int fBlur, double fGaussianBlur)
 {
 	m_pOverlayData = std::make_shared<COverlayData>();
@@ -879,10 +927,17 @@ bool Rasterizer::Rasterize(int xsub, int ysub, int fBlur, double fGaussianBlur)
 
 			byte* src = m_pOutlineData->mWideOutline.empty() ? m_pOverlayData->mpOverlayBufferBody : m_pOverlayData->mpOverlayBufferBorder;
 
-			SeparableFilterX_SSE2(src, tmp, m_pOverlayData->mOverlayWidth, m_pOverlayData->mOverlayHeight, pitch,
-								  filter.kernel, filter.width, filter.divisor);
-			SeparableFilterY_SSE2(tmp, src, m_pOverlayData->mOverlayWidth, m_pOverlayData->mOverlayHeight, pitch,
-								  filter.kernel, filter.width, filter.divisor);
+			if (m_bUseAVX2) {
+				SeparableFilterX_AVX2(src, tmp, m_pOverlayData->mOverlayWidth, m_pOverlayData->mOverlayHeight, pitch,
+									  filter.kernel, filter.width, filter.divisor);
+				SeparableFilterY_AVX2(tmp, src, m_pOverlayData->mOverlayWidth, m_pOverlayData->mOverlayHeight, pitch,
+									  filter.kernel, filter.width, filter.divisor);
+			} else {
+				SeparableFilterX_SSE2(src, tmp, m_pOverlayData->mOverlayWidth, m_pOverlayData->mOverlayHeight, pitch,
+									  filter.kernel, filter.width, filter.divisor);
+				SeparableFilterY_SSE2(tmp, src, m_pOverlayData->mOverlayWidth, m_pOverlayData->mOverlayHeight, pitch,
+									  filter.kernel, filter.width, filter.divisor);
+			}
 
 			_aligned_free(tmp);
 		}
@@ -890,32 +945,20 @@ bool Rasterizer::Rasterize(int xsub, int ysub, int fBlur, double fGaussianBlur)
 
 	// If we're blurring, do a 3x3 box blur
 	// Can't do it on subpictures smaller than 3x3 pixels
-	for (int pass = 0; pass < fBlur; pass++) {
-		if (m_pOverlayData->mOverlayWidth >= 3 && m_pOverlayData->mOverlayHeight >= 3) {
-			int pitch = m_pOverlayData->mOverlayPitch;
+	if (fBlur > 0 && m_pOverlayData->mOverlayWidth >= 3 && m_pOverlayData->mOverlayHeight >= 3) {
+		int pitch = m_pOverlayData->mOverlayPitch;
 
-			byte* tmp = DNew byte[pitch * m_pOverlayData->mOverlayHeight];
-			if (!tmp) {
-				return false;
-			}
-
-			byte* buffer = m_pOutlineData->mWideOutline.empty() ? m_pOverlayData->mpOverlayBufferBody : m_pOverlayData->mpOverlayBufferBorder;
-			memcpy(tmp, buffer, pitch * m_pOverlayData->mOverlayHeight);
-
-			// This could be done in a separated way and win some speed
-			for (ptrdiff_t j = 1; j < m_pOverlayData->mOverlayHeight-1; j++) {
-				byte* src = tmp + pitch*j + 1;
-				byte* dst = buffer + pitch * j + 1;
-
-				for (ptrdiff_t i = 1; i < m_pOverlayData->mOverlayWidth-1; i++, src++, dst++) {
-					*dst = (src[-1-pitch] + (src[-pitch] << 1) + src[+1 - pitch]
-							+ (src[-1] << 1) + (src[0] << 2) + (src[+1] << 1)
-							+ src[-1 +pitch] + (src[+pitch] << 1) + src[+1 +pitch]) >> 4;
-				}
-			}
+		uint16_t* tmp = (uint16_t*)_aligned_malloc(pitch * m_pOverlayData->mOverlayHeight * sizeof(uint16_t), 16);
+		if (!tmp) {
+			return false;
+		}
 
-			delete [] tmp;
+		byte* buffer = m_pOutlineData->mWideOutline.empty() ? m_pOverlayData->mpOverlayBufferBody : m_pOverlayData->mpOverlayBufferBorder;
+		for (int pass = 0; pass < fBlur; pass++) {
+			BeBlurPass(buffer, m_pOverlayData->mOverlayWidth, m_pOverlayData->mOverlayHeight, pitch, tmp);
 		}
+
+		_aligned_free(tmp);
 	}
 
 	return true;
@@ -1691,13 +1734,13 @@ namespace
 // Render a subpicture onto a surface.
 // spd is the surface to render on.
 // clipRect is a rectangular clip region to render inside.
-// pAlphaMask is an alpha clipping mask.
+// pAlphaMask is an alpha clipping mask, nothing is drawn outside of its rectangle.
 // xsub and ysub ???
 // switchpts seems to be an array of fill colours interlaced with coordinates.
 //	switchpts[i*2] contains a colour and switchpts[i*2+1] contains the coordinate to use that colour from
 // fBody tells whether to render the body of the subs.
 // fBorder tells whether to render the border of the subs.
-CRect Rasterizer::Draw(SubPicDesc& spd, CRect& clipRect, byte* pAlphaMask, int xsub, int ysub,
+CRect Rasterizer::Draw(SubPicDesc& spd, CRect& clipRect, const CAlphaMaskRect* pAlphaMask, int xsub, int ysub,
 					   const DWORD* switchpts, bool fBody, bool fBorder) const
 {
 	CRect bbox(0, 0, 0, 0);
@@ -1709,6 +1752,9 @@ CRect Rasterizer::Draw(SubPicDesc& spd, CRect& clipRect, byte* pAlphaMask, int x
 	// Limit drawn area to intersection of rendering surface and rectangular clip area
 	CRect r(0, 0, spd.w, spd.h);
 	r &= clipRect;
+	if (pAlphaMask) {
+		r &= pAlphaMask->rect;
+	}
 
 	// Remember that all subtitle coordinates are specified in 1/8 pixels
 	// (x+4)>>3 rounds to nearest whole pixel.
@@ -1747,7 +1793,8 @@ CRect Rasterizer::Draw(SubPicDesc& spd, CRect& clipRect, byte* pAlphaMask, int x
 
 	BYTE* srcBody = m_pOverlayData->mpOverlayBufferBody + m_pOverlayData->mOverlayPitch * yo + xo;
 	BYTE* srcBorder = m_pOverlayData->mpOverlayBufferBorder + m_pOverlayData->mOverlayPitch * yo + xo;
-	BYTE* alphaMask = pAlphaMask + spd.w * y + x;
+	const int alphaPitch = pAlphaMask ? pAlphaMask->rect.Width() : 0;
+	const BYTE* alphaMask = pAlphaMask ? pAlphaMask->bits + alphaPitch * (y - pAlphaMask->rect.top) + (x - pAlphaMask->rect.left) : nullptr;
 	BYTE* dst = (BYTE*)((DWORD*)(spd.bits + spd.pitch * y) + x);
 	BYTE* s = fBorder ? srcBorder : srcBody;
 
@@ -1791,24 +1838,24 @@ CRect Rasterizer::Draw(SubPicDesc& spd, CRect& clipRect, byte* pAlphaMask, int x
 			ASSERT(s == srcBorder);
 			__assume(s == srcBorder);
 			DrawInternal(m_bUseAVX2, dst, spd.pitch, s, m_pOverlayData->mOverlayPitch, w, h, switchpts, srcBorder,
-						 srcBody, alphaMask, spd.w);
+						 srcBody, alphaMask, alphaPitch);
 			break;
 		case ALPHA | BODY:
 			// Draw single color fill or shadow with alpha mask
 			DrawInternal(m_bUseAVX2, dst, spd.pitch, s, m_pOverlayData->mOverlayPitch, w, h, switchpts, alphaMask,
-						 spd.w);
+						 alphaPitch);
 			break;
 		case ALPHA | SWITCHPOINT:
 			// Draw multi color border with alpha mask
 			ASSERT(s == srcBorder);
 			__assume(s == srcBorder);
 			DrawInternal(m_bUseAVX2, dst, spd.pitch, s, m_pOverlayData->mOverlayPitch, w, h, switchpts, srcBorder,
-						 srcBody, alphaMask, spd.w, xo);
+						 srcBody, alphaMask, alphaPitch, xo);
 			break;
 		case ALPHA | BODY | SWITCHPOINT:
 			// Draw multi color fill or shadow with alpha mask
 			DrawInternal(m_bUseAVX2, dst, spd.pitch, s, m_pOverlayData->mOverlayPitch, w, h, switchpts, alphaMask,
-						 spd.w, xo);
+						 alphaPitch, xo);
 			break;
 		default:
 			ASSERT(FALSE);
@@ -127,6 +127,12 @@ struct COverlayData {
 
 typedef std::shared_ptr<COverlayData> COverlayDataSharedPtr;
 
+// Alpha clipping mask covering rect only, rows are rect.Width() bytes apart
+struct CAlphaMaskRect {
+	const BYTE* bits;
+	CRect rect;
+};
+
 class Rasterizer
 {
 	bool fFirstSet;
@@ -183,6 +189,6 @@ public:
 	bool Rasterize(int xsub, int ysub, int fBlur, double fGaussianBlur);
 	int getOverlayWidth() const;
 
-	CRect Draw(SubPicDesc& spd, CRect& clipRect, byte* pAlphaMask, int xsub, int ysub, const DWORD* switchpts, bool fBody, bool fBorder) const;
+	CRect Draw(SubPicDesc& spd, CRect& clipRect, const CAlphaMaskRect* pAlphaMask, int xsub, int ysub, const DWORD* switchpts, bool fBody, bool fBorder) const;
 	void FillSolidRect(SubPicDesc& spd, int x, int y, int nWidth, int nHeight, DWORD lColor) const;
 };
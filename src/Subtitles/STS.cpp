@@ -23,6 +23,8 @@
 #include "STS.h"
 #include <fstream>
 #include <regex>
+#include <mutex>
+#include <ppl.h>
 #include "RealTextParser.h"
 #include "USFSubtitles.h"
 #include "DSUtil/std_helper.h"
@@ -1668,6 +1670,10 @@ static bool LoadFont(const CString& font)
 		CString fn;
 		fn.Format(L"%sfont%08lx.ttf", path, chksum);
 
+		// fonts are loaded in parallel, the same font must not be written twice at the same time
+		static std::mutex mutexTempFont;
+		std::lock_guard<std::mutex> lock(mutexTempFont);
+
 		if (!::PathFileExistsW(fn)) {
 			CFile f;
 			if (f.Open(fn, CFile::modeCreate|CFile::modeWrite|CFile::typeBinary|CFile::shareDenyNone)) {
@@ -1682,7 +1688,22 @@ static bool LoadFont(const CString& font)
 	return true;
 }
 
-static bool LoadUUEFont(CTextFile* file)
+// UUE encoded fonts collected by the parser, Install() decodes
+// and installs them in parallel and returns when all are done.
+struct CUUEFonts : public std::vector<CString> {
+	void Install() {
+		if (!empty()) {
+			const auto start = GetPerfCounter();
+			concurrency::parallel_for(size_t(0), size(), [&](size_t i) {
+				LoadFont(at(i));
+			});
+			DLog(L"CUUEFonts::Install() : loaded %Iu fonts in %.1f ms", size(), (GetPerfCounter() - start) / 10000.0);
+			clear();
+		}
+	}
+};
+
+static bool LoadUUEFont(CTextFile* file, CUUEFonts& fonts)
 {
 	CString s, font;
 	int cnt = 0;
@@ -1712,7 +1733,10 @@ static bool LoadUUEFont(CTextFile* file)
 			}
 		}
 		if (s.Find(L"fontname:") == 0) {
-			cnt += LoadFont(font);
+			if (!font.IsEmpty()) {
+				fonts.emplace_back(font);
+				cnt++;
+			}
 			font.Empty();
 			continue;
 		}
@@ -1721,7 +1745,8 @@ static bool LoadUUEFont(CTextFile* file)
 	}
 
 	if (!font.IsEmpty()) {
-		cnt += LoadFont(font);
+		fonts.emplace_back(font);
+		cnt++;
 	}
 
 	return cnt ? true : false;
@@ -1729,6 +1754,7 @@ static bool LoadUUEFont(CTextFile* file)
 
 static bool OpenSubStationAlpha(CTextFile* file, CSimpleTextSubtitle& ret, int CharSet)
 {
+	CUUEFonts fonts;
 	bool bRet = false;
 
 	bool script_info = false;
@@ -1970,12 +1996,14 @@ static bool OpenSubStationAlpha(CTextFile* file, CSimpleTextSubtitle& ret, int C
 			bRet = true;
 			events = true;
 		} else if (entry == L"fontname") {
-			if (LoadUUEFont(file)) {
+			if (LoadUUEFont(file, fonts)) {
 				bRet = true;
 			}
 		}
 	}
 
+	fonts.Install();
+
 	return bRet;
 }
 
@@ -1983,6 +2011,7 @@ static bool OpenXombieSub(CTextFile* file, CSimpleTextSubtitle& ret, int CharSet
 {
 	//	CMapStringToPtr stylemap;
 
+	CUUEFonts fonts;
 	CStringW buff;
 	while (file->ReadString(buff)) {
 		FastTrim(buff);
@@ -2113,10 +2142,12 @@ static bool OpenXombieSub(CTextFile* file, CSimpleTextSubtitle& ret, int CharSet
 				return false;
 			}
 		} else if (entry == L"fontname") {
-			LoadUUEFont(file);
+			LoadUUEFont(file, fonts);
 		}
 	}
 
+	fonts.Install();
+
 	return !ret.IsEmpty();
 }
 
@@ -2200,6 +2231,45 @@ const static OpenFunctStruct s_OpenFuncts[] = {
 	Subtitle::RT,   TIME,  OpenRealText,
 };
 
+// Looks at the beginning of the file to pick the parser that is tried first.
+// Returns nullptr if the format is not recognized, the file position is restored.
+static STSOpenFunct SniffSubtitleFormat(CTextFile* f)
+{
+	const ULONGLONG pos = f->GetPosition();
+	STSOpenFunct ret = nullptr;
+
+	CStringW line, prev;
+	for (int i = 0; i < 32 && f->ReadString(line); i++) {
+		FastTrim(line);
+		if (line.IsEmpty()) {
+			continue;
+		}
+
+		if (prev.IsEmpty()) {
+			if (line.Left(6) == L"WEBVTT") {
+				ret = OpenWebVTT;
+				break;
+			}
+			if (line[0] == L'[') {
+				break; // SSA/ASS is tried first anyway
+			}
+		} else {
+			int num, hh, mm, ss;
+			WCHAR sep, wc;
+			if (swscanf_s(prev, L"%d%c", &num, &wc, 1) == 1
+					&& swscanf_s(line, L"%d:%d:%d%c", &hh, &mm, &ss, &sep, 1) == 4
+					&& line.Find(L"-->") > 0) {
+				ret = OpenSubRipper;
+			}
+			break;
+		}
+		prev = line;
+	}
+
+	f->Seek(pos, CFile::begin);
+	return ret;
+}
+
 //
 
 CSimpleTextSubtitle::CSimpleTextSubtitle()
@@ -3081,7 +3151,20 @@ bool CSimpleTextSubtitle::Open(CTextFile* f, int CharSet, CString name)
 
 	ULONGLONG pos = f->GetPosition();
 
+	// try the most likely parser first, the other ones keep their usual order
+	std::vector<const OpenFunctStruct*> openFuncts;
+	openFuncts.reserve(std::size(s_OpenFuncts));
+	const STSOpenFunct sniffed = SniffSubtitleFormat(f);
 	for (const auto& OpenFunct : s_OpenFuncts) {
+		if (OpenFunct.open == sniffed) {
+			openFuncts.insert(openFuncts.begin(), &OpenFunct);
+		} else {
+			openFuncts.push_back(&OpenFunct);
+		}
+	}
+
+	for (const auto pOpenFunct : openFuncts) {
+		const auto& OpenFunct = *pOpenFunct;
 		if (!OpenFunct.open(f, *this, CharSet)) {
 			if (!IsEmpty()) {
 				CString lastLine;
@@ -327,6 +327,160 @@ void SeparableFilterY_SSE2(unsigned char* src, unsigned char* dst, int width, in
 	_aligned_free(tmp);
 }
 
+// Divide the accumulated values by the kernel divisor and store them with saturation,
+// the results are the same as the ones of the SSE2 versions
+static inline void SeparableFilterStore(const int* tmp, unsigned char* out, int width, int divisor,
+										const libdivide::divider<int>& divisorLibdivide)
+{
+	int width16 = width & ~15;
+
+	for (int x = 0; x < width16; x += 16) {
+		__m128i accum1 = _mm_loadu_si128((__m128i*)&tmp[x]) / divisorLibdivide;
+		__m128i accum2 = _mm_loadu_si128((__m128i*)&tmp[x + 4]) / divisorLibdivide;
+		__m128i accum3 = _mm_loadu_si128((__m128i*)&tmp[x + 8]) / divisorLibdivide;
+		__m128i accum4 = _mm_loadu_si128((__m128i*)&tmp[x + 12]) / divisorLibdivide;
+		accum1 = _mm_packus_epi16(_mm_packs_epi32(accum1, accum2), _mm_packs_epi32(accum3, accum4));
+		_mm_store_si128((__m128i*)&out[x], accum1);
+	}
+	for (int x = width16; x < width; x++) {
+		int accum = tmp[x] / divisor;
+		if (accum > 255) {
+			accum = 255;
+		} else if (accum < 0) {
+			accum = 0;
+		}
+		out[x] = (unsigned char)accum;
+	}
+}
+
+// Add two taps of the filter to 16 32-bit sums, in0 and in1 are the values for the taps and
+// coeffs holds the two coefficients in its 32-bit elements. The unpacks work on the 128-bit
+// lanes, lo gets the values 0-3 and 8-11 and hi gets the values 4-7 and 12-15.
+static inline void SeparableFilterTaps_AVX2(const unsigned char* in0, const unsigned char* in1, const __m256i coeffs,
+											__m256i& lo, __m256i& hi)
+{
+	__m256i data0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)in0));
+	__m256i data1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)in1));
+	lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(data0, data1), coeffs));
+	hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(data0, data1), coeffs));
+}
+
+static inline void SeparableFilterStoreTaps_AVX2(int* tmp, const __m256i lo, const __m256i hi)
+{
+	_mm256_storeu_si256((__m256i*)tmp, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i*)(tmp + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+// the coefficients k and k + 1 in one 32-bit integer, the last one is paired with 0
+static inline void SeparableFilterPairs(const short* kernel, int kernel_size, std::vector<int>& pairs)
+{
+	pairs.resize((kernel_size + 1) / 2);
+	for (int k = 0; k < kernel_size; k += 2) {
+		const short next = (k + 1 < kernel_size) ? kernel[k + 1] : 0;
+		pairs[k / 2] = (int)(((unsigned)(unsigned short)next << 16) | (unsigned short)kernel[k]);
+	}
+}
+
+// Filter an image in horizontal direction with a one-dimensional filter. The sums of
+// the taps are kept in registers for 16 pixels, only the pixels near the borders use
+// the scalar code.
+void SeparableFilterX_AVX2(unsigned char* src, unsigned char* dst, int width, int height, ptrdiff_t stride,
+						   short* kernel, int kernel_size, int divisor)
+{
+	int* tmp = (int*)_aligned_malloc(stride * sizeof(int), 32);
+	libdivide::divider<int> divisorLibdivide(divisor);
+
+	std::vector<int> pairs;
+	SeparableFilterPairs(kernel, kernel_size, pairs);
+
+	const int kOffset = kernel_size / 2;
+
+	for (int y = 0; y < height; y++) {
+		const unsigned char* in = src + y * stride;
+		unsigned char* out = dst + y * stride;
+
+		auto FilterPixel = [&](int x) {
+			int accum = 0;
+			for (int k = std::max(0, kOffset - x); k < kernel_size && x + k - kOffset < width; k++) {
+				accum += (int)(in[x + k - kOffset] * kernel[k]);
+			}
+			tmp[x] = accum;
+		};
+
+		int x = 0;
+		for (; x < std::min(kOffset, width); x++) {
+			FilterPixel(x);
+		}
+		// the last pair of taps reads one value after the kernel
+		for (; x + 16 + kOffset < width; x += 16) {
+			__m256i lo = _mm256_setzero_si256();
+			__m256i hi = _mm256_setzero_si256();
+			const unsigned char* p = in + x - kOffset;
+			for (int k = 0; k < kernel_size; k += 2) {
+				SeparableFilterTaps_AVX2(p + k, p + k + 1, _mm256_set1_epi32(pairs[k / 2]), lo, hi);
+			}
+			SeparableFilterStoreTaps_AVX2(&tmp[x], lo, hi);
+		}
+		for (; x < width; x++) {
+			FilterPixel(x);
+		}
+
+		SeparableFilterStore(tmp, out, width, divisor, divisorLibdivide);
+	}
+
+	_aligned_free(tmp);
+}
+
+// Filter an image in vertical direction with a one-dimensional filter
+void SeparableFilterY_AVX2(unsigned char* src, unsigned char* dst, int width, int height, ptrdiff_t stride,
+						   short* kernel, int kernel_size, int divisor)
+{
+	int* tmp = (int*)_aligned_malloc(stride * sizeof(int), 32);
+	libdivide::divider<int> divisorLibdivide(divisor);
+
+	const int kOffset = kernel_size / 2;
+
+	for (int y = 0; y < height; y++) {
+		const unsigned char* in = src + y * stride;
+		unsigned char* out = dst + y * stride;
+
+		int kStart = 0;
+		int kEnd = kernel_size;
+		if (y < kOffset) { // 0 > y - kOffset
+			kStart += kOffset - y;
+		} else if (height <= y + kOffset) {
+			kEnd -= kOffset + y + 1 - height;
+		}
+
+		int x = 0;
+		for (; x + 16 <= width; x += 16) {
+			__m256i lo = _mm256_setzero_si256();
+			__m256i hi = _mm256_setzero_si256();
+			for (int k = kStart; k < kEnd; k += 2) {
+				const unsigned char* row0 = in + (k - kOffset) * stride + x;
+				if (k + 1 < kEnd) {
+					const int coeffs = (int)(((unsigned)(unsigned short)kernel[k + 1] << 16) | (unsigned short)kernel[k]);
+					SeparableFilterTaps_AVX2(row0, row0 + stride, _mm256_set1_epi32(coeffs), lo, hi);
+				} else {
+					SeparableFilterTaps_AVX2(row0, row0, _mm256_set1_epi32((unsigned short)kernel[k]), lo, hi);
+				}
+			}
+			SeparableFilterStoreTaps_AVX2(&tmp[x], lo, hi);
+		}
+		for (; x < width; x++) {
+			int accum = 0;
+			for (int k = kStart; k < kEnd; k++) {
+				accum += (int)(in[(k - kOffset) * stride + x] * kernel[k]);
+			}
+			tmp[x] = accum;
+		}
+
+		SeparableFilterStore(tmp, out, width, divisor, divisorLibdivide);
+	}
+
+	_aligned_free(tmp);
+}
+
 static inline double NormalDist(double sigma, double x)
 {
 	if (sigma <= 0.0 && x == 0.0) {
@@ -21,12 +21,124 @@
 
 #include "stdafx.h"
 #include <afxinet.h>
+#include <emmintrin.h>
 #include "TextFile.h"
 #include <Utf8.h>
 #include "DSUtil/FileHandle.h"
 #include "DSUtil/HTTPAsync.h"
 
-#define TEXTFILE_BUFFER_SIZE (64 * 1024)
+#define TEXTFILE_BUFFER_SIZE (256 * 1024)
+
+//
+// SSE2 helpers for the decoding loops, they process the common case (plain characters
+// up to the end of line) in blocks and leave everything else to the per-character code.
+//
+
+// Returns the position of the first CR or LF, or len if there is none.
+static size_t FindLineEnd(const char* src, const size_t len)
+{
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+		if (mask) {
+			unsigned long idx;
+			_BitScanForward(&idx, mask);
+			return i + idx;
+		}
+	}
+	for (; i < len; i++) {
+		if (src[i] == '\r' || src[i] == '\n') {
+			break;
+		}
+	}
+
+	return i;
+}
+
+// Same as above for little-endian UTF-16, len is in characters.
+static size_t FindLineEnd(const WCHAR* src, const size_t len)
+{
+	const __m128i cr = _mm_set1_epi16(L'\r');
+	const __m128i lf = _mm_set1_epi16(L'\n');
+
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, cr), _mm_cmpeq_epi16(v, lf)));
+		if (mask) {
+			unsigned long idx;
+			_BitScanForward(&idx, mask);
+			return i + idx / sizeof(WCHAR);
+		}
+	}
+	for (; i < len; i++) {
+		if (src[i] == L'\r' || src[i] == L'\n') {
+			break;
+		}
+	}
+
+	return i;
+}
+
+// Widens the leading run of ASCII characters (excluding CR and LF) from a UTF-8 buffer,
+// returns the number of characters written to dst.
+static size_t WidenAsciiRun(const char* src, const size_t len, WCHAR* dst)
+{
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf));
+		if (_mm_movemask_epi8(_mm_or_si128(v, stop))) { // non ASCII byte or end of line
+			break;
+		}
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(v, zero));
+		_mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+	}
+	for (; i < len; i++) {
+		const char c = src[i];
+		if ((c & 0x80) || c == '\r' || c == '\n') {
+			break;
+		}
+		dst[i] = (WCHAR)c;
+	}
+
+	return i;
+}
+
+// Byte-swaps the leading run of big-endian UTF-16 characters (excluding CR and LF),
+// len is in characters. Returns the number of characters written to dst.
+static size_t SwapBE16Run(const char* src, const size_t len, WCHAR* dst)
+{
+	const __m128i cr = _mm_set1_epi16(L'\r');
+	const __m128i lf = _mm_set1_epi16(L'\n');
+
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i * sizeof(WCHAR)));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, cr), _mm_cmpeq_epi16(v, lf)))) {
+			break;
+		}
+		_mm_storeu_si128((__m128i*)(dst + i), v);
+	}
+	for (; i < len; i++) {
+		const WCHAR c = (WCHAR(BYTE(src[i * 2])) << 8) | WCHAR(BYTE(src[i * 2 + 1]));
+		if (c == L'\r' || c == L'\n') {
+			break;
+		}
+		dst[i] = c;
+	}
+
+	return i;
+}
 
 CTextFile::CTextFile(enc encoding/* = ASCII*/, enc defaultencoding/* = ASCII*/)
 	: m_encoding(encoding)
@@ -317,13 +429,7 @@ BOOL CTextFile::ReadString(CStringA& str)
 		do {
 			int nCharsRead;
 
-			for (nCharsRead = 0; m_posInBuffer + nCharsRead < m_nInBuffer; nCharsRead++) {
-				if (m_buffer[m_posInBuffer + nCharsRead] == '\n') {
-					break;
-				} else if (m_buffer[m_posInBuffer + nCharsRead] == '\r') {
-					break;
-				}
-			}
+			nCharsRead = (int)FindLineEnd(&m_buffer[m_posInBuffer], size_t(m_nInBuffer - m_posInBuffer));
 
 			str.Append(&m_buffer[m_posInBuffer], nCharsRead);
 
@@ -533,13 +639,7 @@ BOOL CTextFile::ReadString(CStringW& str)
 		do {
 			int nCharsRead;
 
-			for (nCharsRead = 0; m_posInBuffer + nCharsRead < m_nInBuffer; nCharsRead++) {
-				if (m_buffer[m_posInBuffer + nCharsRead] == '\n') {
-					break;
-				} else if (m_buffer[m_posInBuffer + nCharsRead] == '\r') {
-					break;
-				}
-			}
+			nCharsRead = (int)FindLineEnd(&m_buffer[m_posInBuffer], size_t(m_nInBuffer - m_posInBuffer));
 
 			// TODO: codepage
 			str.Append(CStringW(&m_buffer[m_posInBuffer], nCharsRead));
@@ -570,6 +670,15 @@ BOOL CTextFile::ReadString(CStringW& str)
 			int nCharsRead;
 
 			for (nCharsRead = 0; m_posInBuffer < m_nInBuffer; m_posInBuffer++, nCharsRead++) {
+				const size_t n = WidenAsciiRun(&m_buffer[m_posInBuffer], size_t(m_nInBuffer - m_posInBuffer), &m_wbuffer[nCharsRead]);
+				if (n) {
+					m_posInBuffer += n;
+					nCharsRead += (int)n;
+					if (m_posInBuffer >= m_nInBuffer) {
+						break;
+					}
+				}
+
 				if (Utf8::isSingleByte(m_buffer[m_posInBuffer])) { // 0xxxxxxx
 					m_wbuffer[nCharsRead] = m_buffer[m_posInBuffer] & 0x7f;
 				} else if (Utf8::isFirstOfMultibyte(m_buffer[m_posInBuffer])) {
@@ -664,13 +773,8 @@ BOOL CTextFile::ReadString(CStringW& str)
 			int nCharsRead;
 			WCHAR* wbuffer = (WCHAR*)&m_buffer[m_posInBuffer];
 
-			for (nCharsRead = 0; m_posInBuffer + 1 < m_nInBuffer; nCharsRead++, m_posInBuffer += sizeof(WCHAR)) {
-				if (wbuffer[nCharsRead] == L'\n') {
-					break; // Stop at end of line
-				} else if (wbuffer[nCharsRead] == L'\r') {
-					break; // Skip \r
-				}
-			}
+			nCharsRead = (int)FindLineEnd(wbuffer, size_t(m_nInBuffer - m_posInBuffer) / sizeof(WCHAR));
+			m_posInBuffer += nCharsRead * sizeof(WCHAR);
 
 			str.Append(wbuffer, nCharsRead);
 
@@ -699,6 +803,15 @@ BOOL CTextFile::ReadString(CStringW& str)
 			int nCharsRead;
 
 			for (nCharsRead = 0; m_posInBuffer + 1 < m_nInBuffer; nCharsRead++, m_posInBuffer += sizeof(WCHAR)) {
+				const size_t n = SwapBE16Run(&m_buffer[m_posInBuffer], size_t(m_nInBuffer - m_posInBuffer) / sizeof(WCHAR), &m_wbuffer[nCharsRead]);
+				if (n) {
+					m_posInBuffer += n * sizeof(WCHAR);
+					nCharsRead += (int)n;
+					if (m_posInBuffer + 1 >= m_nInBuffer) {
+						break;
+					}
+				}
+
 				m_wbuffer[nCharsRead] = ((WCHAR(m_buffer[m_posInBuffer]) << 8) & 0xff00) | (WCHAR(m_buffer[m_posInBuffer + 1]) & 0x00ff);
 				if (m_wbuffer[nCharsRead] == L'\n') {
 					bLineEndFound = true; // Stop at end of line
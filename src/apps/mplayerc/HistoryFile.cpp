@@ -26,7 +26,7 @@
 // CMpcLstFile
 //
 
-FILE* CMpcLstFile::CheckOpenFileForRead(bool& valid)
+FILE* CMpcLstFile::CheckOpenFileForRead(bool& valid, bool bForce/* = false*/)
 {
 	if (!::PathFileExistsW(m_filename)) {
 		valid = false;
@@ -34,7 +34,7 @@ FILE* CMpcLstFile::CheckOpenFileForRead(bool& valid)
 	}
 
 	const DWORD tick = GetTickCount();
-	if (m_LastAccessTick && std::labs(tick - m_LastAccessTick) < 100) {
+	if (!bForce && m_LastAccessTick && std::labs(tick - m_LastAccessTick) < 100) {
 		valid = true;
 		return nullptr;
 	}
@@ -55,12 +55,12 @@ FILE* CMpcLstFile::CheckOpenFileForRead(bool& valid)
 	return pFile;
 }
 
-FILE* CMpcLstFile::OpenFileForWrite()
+FILE* CMpcLstFile::OpenFileForWrite(bool bAppend/* = false*/, LPCWSTR filename/* = nullptr*/)
 {
 	FILE* pFile;
 
 	do { // Open file, retry if it is already being used by another process
-		pFile = _wfsopen(m_filename, L"w, ccs=UTF-8", _SH_SECURE);
+		pFile = _wfsopen(filename ? filename : m_filename.GetString(), bAppend ? L"a, ccs=UTF-8" : L"w, ccs=UTF-8", _SH_SECURE);
 		if (pFile || (GetLastError() != ERROR_SHARING_VIOLATION)) {
 			break;
 		}
@@ -105,10 +105,10 @@ void CMpcLstFile::SetMaxCount(unsigned maxcount)
 // CSessionFile
 //
 
-bool CSessionFile::ReadFile()
+bool CSessionFile::ReadFile(bool bForce/* = false*/)
 {
 	bool valid = false;
-	FILE* pFile = CheckOpenFileForRead(valid);
+	FILE* pFile = CheckOpenFileForRead(valid, bForce);
 	if (!pFile) {
 		return valid;
 	}
@@ -121,13 +121,21 @@ bool CSessionFile::ReadFile()
 	CStringW section;
 	CStringW line;
 
+	auto AddEntry = [&]() {
+		if (section[0] == '+') { // journal entry
+			IntApplyJournalEntry(sesInfo);
+		} else {
+			IntAddEntry(sesInfo);
+		}
+	};
+
 	while (file.ReadString(line)) {
 		int pos = 0;
 
 		if (line[0] == '[') { // new section
 			if (section.GetLength()) {
+				AddEntry();
 				section.Empty();
-				IntAddEntry(sesInfo);
 				sesInfo = {};
 			}
 
@@ -205,54 +213,211 @@ bool CSessionFile::ReadFile()
 	CloseFile(pFile);
 
 	if (section.GetLength()) {
-		IntAddEntry(sesInfo);
+		AddEntry();
 	}
 
 	return true;
 }
 
+void CSessionFile::FormatSessionInfo(CStringW& str, const SessionInfo& sesInfo)
+{
+	str.AppendFormat(L"Path=%s\n", sesInfo.Path);
+
+	if (sesInfo.Title.GetLength()) {
+		str.AppendFormat(L"Title=%s\n", sesInfo.Title);
+	}
+
+	if (sesInfo.DVDId) {
+		str.AppendFormat(L"DVDId=%016I64x\n", sesInfo.DVDId);
+		if (sesInfo.DVDTitle) {
+			str.AppendFormat(L"DVDPosition=%02u,%02u:%02u:%02u\n",
+				(unsigned)sesInfo.DVDTitle,
+				(unsigned)sesInfo.DVDTimecode.bHours,
+				(unsigned)sesInfo.DVDTimecode.bMinutes,
+				(unsigned)sesInfo.DVDTimecode.bSeconds);
+		}
+		if (sesInfo.DVDState.size()) {
+			int nDestLen = Base64EncodeGetRequiredLength(sesInfo.DVDState.size());
+			CStringA base64;
+			BOOL ret = Base64Encode(sesInfo.DVDState.data(), sesInfo.DVDState.size(), base64.GetBuffer(nDestLen), &nDestLen, ATL_BASE64_FLAG_NOCRLF);
+			if (ret) {
+				base64.ReleaseBufferSetLength(nDestLen);
+				str.AppendFormat(L"DVDState=%hs\n", base64);
+			}
+		}
+	}
+	else {
+		if (sesInfo.Position > UNITS) {
+			LONGLONG seconds = sesInfo.Position / UNITS;
+			int h = (int)(seconds / 3600);
+			int m = (int)(seconds / 60 % 60);
+			int s = (int)(seconds % 60);
+			str.AppendFormat(L"Position=%02d:%02d:%02d\n", h, m, s);
+		}
+		if (sesInfo.AudioNum >= 0) {
+			str.AppendFormat(L"AudioNum=%d\n", sesInfo.AudioNum + 1);
+		}
+		if (sesInfo.SubtitleNum >= 0) {
+			str.AppendFormat(L"SubtitleNum=%d\n", sesInfo.SubtitleNum + 1);
+		}
+		if (sesInfo.AudioPath.GetLength()) {
+			str.AppendFormat(L"AudioPath=%s\n", sesInfo.AudioPath);
+		}
+		if (sesInfo.SubtitlePath.GetLength()) {
+			str.AppendFormat(L"SubtitlePath=%s\n", sesInfo.SubtitlePath);
+		}
+	}
+}
+
 //
 // CHistoryFile
 //
 
+std::wstring CHistoryFile::GetKey(const SessionInfo& sesInfo)
+{
+	if (sesInfo.DVDId) {
+		CStringW key;
+		key.Format(L"|dvd:%016I64x", sesInfo.DVDId); // '|' is not allowed in paths
+		return key.GetString();
+	}
+
+	CStringW key(sesInfo.Path);
+	return key.MakeLower().GetString();
+}
+
 void CHistoryFile::IntAddEntry(const SessionInfo& sesInfo)
 {
 	if (sesInfo.Path.GetLength()) {
-		m_SessionInfos.emplace_back(sesInfo);
+		// the first entry wins, unexpected duplicates (for example, after manual editing) are dropped
+		auto [it, inserted] = m_SessionIndex.try_emplace(GetKey(sesInfo), m_SessionInfos.end());
+		if (inserted) {
+			it->second = m_SessionInfos.emplace(m_SessionInfos.end(), sesInfo);
+		}
+	}
+}
+
+void CHistoryFile::IntApplyJournalEntry(const SessionInfo& sesInfo)
+{
+	if (sesInfo.Path.GetLength()) {
+		PutFront(sesInfo, FindSessionInfo(sesInfo));
+		m_nJournalEntries++;
 	}
 }
 
 void CHistoryFile::IntClearEntries()
 {
 	m_SessionInfos.clear();
+	m_SessionIndex.clear();
+	m_nJournalEntries = 0;
 }
 
-std::list<SessionInfo>::iterator CHistoryFile::FindSessionInfo(const SessionInfo& sesInfo, std::list<SessionInfo>::iterator begin)
+std::list<SessionInfo>::iterator CHistoryFile::FindSessionInfo(const SessionInfo& sesInfo)
 {
-	if (sesInfo.DVDId) {
-		for (auto it = begin; it != m_SessionInfos.end(); ++it) {
-			if (sesInfo.DVDId == (*it).DVDId) {
-				return it;
-			}
-		}
+	if (!sesInfo.DVDId && sesInfo.Path.IsEmpty()) {
+		ASSERT(0);
+		return m_SessionInfos.end();
 	}
-	else if (sesInfo.Path.GetLength()) {
-		for (auto it = begin; it != m_SessionInfos.end(); ++it) {
-			if (sesInfo.Path.CompareNoCase((*it).Path) == 0) {
-				return it;
-			}
-		}
+
+	const auto it = m_SessionIndex.find(GetKey(sesInfo));
+	return it != m_SessionIndex.end() ? it->second : m_SessionInfos.end();
+}
+
+void CHistoryFile::PutFront(const SessionInfo& sesInfo, std::list<SessionInfo>::iterator it)
+{
+	if (it != m_SessionInfos.end()) {
+		*it = sesInfo;
+		m_SessionInfos.splice(m_SessionInfos.begin(), m_SessionInfos, it);
+	} else {
+		m_SessionIndex[GetKey(sesInfo)] = m_SessionInfos.emplace(m_SessionInfos.begin(), sesInfo);
 	}
-	else {
-		ASSERT(0);
+}
+
+void CHistoryFile::Trim()
+{
+	while (m_SessionInfos.size() > m_maxCount) {
+		m_SessionIndex.erase(GetKey(m_SessionInfos.back()));
+		m_SessionInfos.pop_back();
+	}
+}
+
+bool CHistoryFile::UpdateFileStamp()
+{
+	UINT64 size = 0;
+	UINT64 time = 0;
+
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (GetFileAttributesExW(m_filename, GetFileExInfoStandard, &fad)) {
+		size = ((UINT64)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+		time = ((UINT64)fad.ftLastWriteTime.dwHighDateTime << 32) | fad.ftLastWriteTime.dwLowDateTime;
 	}
 
-	return m_SessionInfos.end();
+	const bool changed = !m_bFileStampValid || size != m_fileSize || time != m_fileTime;
+	m_fileSize = size;
+	m_fileTime = time;
+	m_bFileStampValid = true;
+
+	return changed;
+}
+
+bool CHistoryFile::ReadFileIfChanged()
+{
+	if (!UpdateFileStamp()) {
+		return true; // the entries in memory are up to date
+	}
+
+	if (!ReadFile(true)) {
+		return false;
+	}
+
+	Trim();
+	return true;
+}
+
+bool CHistoryFile::AppendJournal(const SessionInfo& sesInfo)
+{
+	// compact when the journal becomes a noticeable part of the file
+	if (!m_fileSize || m_nJournalEntries >= std::max(m_maxCount / 4, 16u)) {
+		return WriteFile();
+	}
+
+	FILE* pFile = OpenFileForWrite(true);
+	if (!pFile) {
+		return false;
+	}
+
+	bool ret = true;
+
+	CStdioFile file(pFile);
+	CStringW str(L"\n[+]\n");
+	FormatSessionInfo(str, sesInfo);
+	try {
+		// one write per entry, an interrupted write can only damage this entry
+		file.WriteString(str);
+		file.Flush();
+	}
+	catch (CFileException& e) {
+		// Fail silently if disk is full
+		UNREFERENCED_PARAMETER(e);
+		ASSERT(FALSE);
+		ret = false;
+	}
+
+	CloseFile(pFile);
+	UpdateFileStamp();
+
+	if (ret) {
+		m_nJournalEntries++;
+	}
+
+	return ret;
 }
 
 bool CHistoryFile::WriteFile()
 {
-	FILE* pFile = OpenFileForWrite();
+	// write to a temporary file and replace the old file only after the new one is complete
+	const CStringW tmpFilename = m_filename + L".tmp";
+
+	FILE* pFile = OpenFileForWrite(false, tmpFilename);
 	if (!pFile) {
 		return false;
 	}
@@ -267,56 +432,11 @@ bool CHistoryFile::WriteFile()
 		for (const auto& sesInfo : m_SessionInfos) {
 			if (sesInfo.Path.GetLength()) {
 				str.Format(L"\n[%03d]\n", i++);
-
-				str.AppendFormat(L"Path=%s\n", sesInfo.Path);
-
-				if (sesInfo.Title.GetLength()) {
-					str.AppendFormat(L"Title=%s\n", sesInfo.Title);
-				}
-
-				if (sesInfo.DVDId) {
-					str.AppendFormat(L"DVDId=%016I64x\n", sesInfo.DVDId);
-					if (sesInfo.DVDTitle) {
-						str.AppendFormat(L"DVDPosition=%02u,%02u:%02u:%02u\n",
-							(unsigned)sesInfo.DVDTitle,
-							(unsigned)sesInfo.DVDTimecode.bHours,
-							(unsigned)sesInfo.DVDTimecode.bMinutes,
-							(unsigned)sesInfo.DVDTimecode.bSeconds);
-					}
-					if (sesInfo.DVDState.size()) {
-						int nDestLen = Base64EncodeGetRequiredLength(sesInfo.DVDState.size());
-						CStringA base64;
-						BOOL ret2 = Base64Encode(sesInfo.DVDState.data(), sesInfo.DVDState.size(), base64.GetBuffer(nDestLen), &nDestLen, ATL_BASE64_FLAG_NOCRLF);
-						if (ret2) {
-							base64.ReleaseBufferSetLength(nDestLen);
-							str.AppendFormat(L"DVDState=%hs\n", base64);
-						}
-					}
-				}
-				else {
-					if (sesInfo.Position > UNITS) {
-						LONGLONG seconds = sesInfo.Position / UNITS;
-						int h = (int)(seconds / 3600);
-						int m = (int)(seconds / 60 % 60);
-						int s = (int)(seconds % 60);
-						str.AppendFormat(L"Position=%02d:%02d:%02d\n", h, m, s);
-					}
-					if (sesInfo.AudioNum >= 0) {
-						str.AppendFormat(L"AudioNum=%d\n", sesInfo.AudioNum + 1);
-					}
-					if (sesInfo.SubtitleNum >= 0) {
-						str.AppendFormat(L"SubtitleNum=%d\n", sesInfo.SubtitleNum + 1);
-					}
-					if (sesInfo.AudioPath.GetLength()) {
-						str.AppendFormat(L"AudioPath=%s\n", sesInfo.AudioPath);
-					}
-					if (sesInfo.SubtitlePath.GetLength()) {
-						str.AppendFormat(L"SubtitlePath=%d\n", sesInfo.SubtitlePath);
-					}
-				}
+				FormatSessionInfo(str, sesInfo);
 				file.WriteString(str);
 			}
 		}
+		file.Flush();
 	}
 	catch (CFileException& e) {
 		// Fail silently if disk is full
@@ -327,17 +447,35 @@ bool CHistoryFile::WriteFile()
 
 	CloseFile(pFile);
 
+	if (ret) {
+		ret = !!MoveFileExW(tmpFilename, m_filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+	}
+	if (!ret) {
+		_wremove(tmpFilename);
+	}
+
+	m_nJournalEntries = 0;
+	UpdateFileStamp();
+
 	return ret;
 }
 
+void CHistoryFile::SetFilename(const CStringW& filename)
+{
+	__super::SetFilename(filename);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_bFileStampValid = false;
+}
+
 bool CHistoryFile::OpenSessionInfo(SessionInfo& sesInfo, bool bReadPos)
 {
 	std::lock_guard<std::mutex> lock(m_Mutex);
 
-	ReadFile();
+	ReadFileIfChanged();
 
 	bool found = false;
-	auto it = FindSessionInfo(sesInfo, m_SessionInfos.begin());
+	auto it = FindSessionInfo(sesInfo);
 
 	if (it != m_SessionInfos.end()) {
 		found = true;
@@ -364,16 +502,9 @@ bool CHistoryFile::OpenSessionInfo(SessionInfo& sesInfo, bool bReadPos)
 	}
 
 	if (it != m_SessionInfos.begin() || !found) { // not first entry or empty list
-		if (found) {
-			m_SessionInfos.erase(it);
-		}
-
-		m_SessionInfos.emplace_front(sesInfo);
-
-		while (m_SessionInfos.size() > m_maxCount) {
-			m_SessionInfos.pop_back();
-		}
-		WriteFile();
+		PutFront(sesInfo, it);
+		Trim();
+		AppendJournal(sesInfo);
 	}
 
 	return found;
@@ -383,47 +514,35 @@ void CHistoryFile::SaveSessionInfo(const SessionInfo& sesInfo)
 {
 	std::lock_guard<std::mutex> lock(m_Mutex);
 
-	ReadFile();
-
-	if (m_SessionInfos.size()) {
-		auto it = FindSessionInfo(sesInfo, m_SessionInfos.begin());
-
-		if (it == m_SessionInfos.begin() && sesInfo.Equals(*it)) {
-			return;
-		}
-
-		if (it != m_SessionInfos.end()) {
-			m_SessionInfos.erase(it);
-		}
-	}
+	ReadFileIfChanged();
 
-	m_SessionInfos.emplace_front(sesInfo); // Writing new data
+	auto it = FindSessionInfo(sesInfo);
 
-	while (m_SessionInfos.size() > m_maxCount) {
-		m_SessionInfos.pop_back();
+	if (it != m_SessionInfos.end() && it == m_SessionInfos.begin() && sesInfo.Equals(*it)) {
+		return;
 	}
 
-	WriteFile();
+	PutFront(sesInfo, it); // Writing new data
+	Trim();
+	AppendJournal(sesInfo);
 }
 
 bool CHistoryFile::DeleteSessions(const std::list<SessionInfo>& sessions)
 {
 	std::lock_guard<std::mutex> lock(m_Mutex);
 
-	if (!ReadFile()) {
+	if (!ReadFileIfChanged()) {
 		return false;
 	}
 
 	bool changed = false;
 
 	for (const auto& sesInfo : sessions) {
-		auto it = FindSessionInfo(sesInfo, m_SessionInfos.begin());
-
-		// delete what was found and all unexpected duplicates (for example, after manual editing)
-		while (it != m_SessionInfos.end()) {
-			m_SessionInfos.erase(it++);
+		auto it = FindSessionInfo(sesInfo);
+		if (it != m_SessionInfos.end()) {
+			m_SessionIndex.erase(GetKey(*it));
+			m_SessionInfos.erase(it);
 			changed = true;
-			it = FindSessionInfo(sesInfo, it);
 		}
 	}
 
@@ -434,12 +553,28 @@ bool CHistoryFile::DeleteSessions(const std::list<SessionInfo>& sessions)
 	return true; // already deleted
 }
 
+bool CHistoryFile::Compact()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// also picks up the journal entries appended by other instances
+	if (!ReadFileIfChanged()) {
+		return false;
+	}
+
+	if (m_nJournalEntries) {
+		return WriteFile();
+	}
+
+	return true;
+}
+
 void CHistoryFile::GetRecentPaths(std::vector<CStringW>& recentPaths, unsigned count)
 {
 	std::lock_guard<std::mutex> lock(m_Mutex);
 
 	recentPaths.clear();
-	ReadFile();
+	ReadFileIfChanged();
 
 	if (count > m_SessionInfos.size()) {
 		count = m_SessionInfos.size();
@@ -459,7 +594,7 @@ void CHistoryFile::GetRecentSessions(std::vector<SessionInfo>& recentSessions, u
 	std::lock_guard<std::mutex> lock(m_Mutex);
 
 	recentSessions.clear();
-	ReadFile();
+	ReadFileIfChanged();
 
 	if (count > m_SessionInfos.size()) {
 		count = m_SessionInfos.size();
@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include <unordered_map>
+
 struct SessionInfo {
 	CStringW Path;
 	CStringW Title;
@@ -81,8 +83,8 @@ protected:
 	CStringW m_filename;
 	unsigned m_maxCount = 100;
 
-	FILE* CheckOpenFileForRead(bool& valid);
-	FILE* OpenFileForWrite();
+	FILE* CheckOpenFileForRead(bool& valid, bool bForce = false);
+	FILE* OpenFileForWrite(bool bAppend = false, LPCWSTR filename = nullptr);
 	void CloseFile(FILE*& pFile);
 
 	virtual void IntClearEntries() = 0;
@@ -102,28 +104,55 @@ class CSessionFile : public CMpcLstFile
 {
 protected:
 	virtual void IntAddEntry(const SessionInfo& sesInfo) = 0;
-	bool ReadFile();
+	virtual void IntApplyJournalEntry(const SessionInfo& sesInfo) { IntAddEntry(sesInfo); }
+	bool ReadFile(bool bForce = false);
+
+	static void FormatSessionInfo(CStringW& str, const SessionInfo& sesInfo);
 };
 
 //
 // CHistoryFile
 //
 
+// The entries are kept in recently used order with a hash index by path or DVD id.
+// Updates are appended to the file as journal sections "[+]",
+// the whole file is rewritten (compacted) only when the journal grows too long and on exit,
+// so older versions that don't know about the journal find the current entries.
+
 class CHistoryFile : public CSessionFile
 {
 private:
 	std::list<SessionInfo> m_SessionInfos;
+	std::unordered_map<std::wstring, std::list<SessionInfo>::iterator> m_SessionIndex;
+	unsigned m_nJournalEntries = 0;
+
+	// size and modification time of the file after our last read or write
+	UINT64 m_fileSize = 0;
+	UINT64 m_fileTime = 0;
+	bool m_bFileStampValid = false;
+
+	static std::wstring GetKey(const SessionInfo& sesInfo);
 
 	void IntAddEntry(const SessionInfo& sesInfo) override;
+	void IntApplyJournalEntry(const SessionInfo& sesInfo) override;
 	void IntClearEntries() override;
 
-	std::list<SessionInfo>::iterator FindSessionInfo(const SessionInfo& sesInfo, std::list<SessionInfo>::iterator begin);
+	std::list<SessionInfo>::iterator FindSessionInfo(const SessionInfo& sesInfo);
+	void PutFront(const SessionInfo& sesInfo, std::list<SessionInfo>::iterator it);
+	void Trim();
+
+	bool UpdateFileStamp(); // returns true if the file was changed by someone else
+	bool ReadFileIfChanged();
+	bool AppendJournal(const SessionInfo& sesInfo);
 	bool WriteFile();
 
 public:
+	void SetFilename(const CStringW& filename) override;
+
 	bool OpenSessionInfo(SessionInfo& sesInfo, bool bReadPos); // Read or create an entry in the history file
 	void SaveSessionInfo(const SessionInfo& sesInfo);
 	bool DeleteSessions(const std::list<SessionInfo>& sessions);
+	bool Compact(); // Merge the journal into the main entries
 
 	void GetRecentPaths(std::vector<CStringW>& recentPaths, unsigned count);
 	void GetRecentSessions(std::vector<SessionInfo>& recentSessions, unsigned count);
@@ -6277,6 +6277,7 @@ HRESULT CMainFrame::RenderCurrentSubtitles(BYTE* pData)
 			RECT bbox = {};
 			hr = pSubPicProvider->Render(spdRender, rtNow, m_pCAP->GetFPS(), bbox);
 			if (S_OK == hr) {
+				memSubPic.Unlock(&bbox); // only the rendered rows are blended
 				SubPicDesc spdTarget = {};
 				spdTarget.w       = width;
 				spdTarget.h       = height;
@@ -0,0 +1,317 @@
+/*
+ * (C) 2026 see Authors.txt
+ *
+ * This file is part of MPC-BE.
+ *
+ * MPC-BE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MPC-BE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "stdafx.h"
+#include <MediaInfo/MediaInfo.h>
+#include "MediaProbe.h"
+
+using namespace MediaInfoLib;
+
+#define MEDIAPROBE_CACHE_MAX     50000
+#define MEDIAPROBE_SAVE_INTERVAL 30000 // ms
+
+CMediaProbe::~CMediaProbe()
+{
+	Stop();
+}
+
+bool CMediaProbe::GetFileInfo(const CString& fn, UINT64& size, UINT64& mtime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!::GetFileAttributesExW(fn, GetFileExInfoStandard, &fad) || (fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+		return false;
+	}
+
+	size = ((UINT64)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+	mtime = ((UINT64)fad.ftLastWriteTime.dwHighDateTime << 32) | fad.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+std::wstring CMediaProbe::GetKey(const CString& fn)
+{
+	CString key(fn);
+	return key.MakeLower().GetString();
+}
+
+void CMediaProbe::Start(HWND hNotifyWnd, UINT nNotifyMsg, const CString& cacheFile)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_hNotifyWnd = hNotifyWnd;
+	m_nNotifyMsg = nNotifyMsg;
+	m_cacheFile = cacheFile;
+	m_bExit = false;
+	m_nLastSave = GetTickCount64();
+
+	LoadCache();
+}
+
+void CMediaProbe::Stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bExit = true;
+		m_tasks.clear();
+		m_hNotifyWnd = nullptr;
+	}
+	m_cond.notify_all();
+
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+	m_workers.clear();
+
+	SaveCache();
+}
+
+bool CMediaProbe::Query(UINT id, const CString& fn, REFERENCE_TIME& duration, CString& title)
+{
+	UINT64 size, mtime;
+	if (!GetFileInfo(fn, size, mtime)) {
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	const auto it = m_cache.find(GetKey(fn));
+	if (it != m_cache.end() && it->second.size == size && it->second.mtime == mtime) {
+		it->second.stamp = ++m_nStamp;
+		duration = it->second.duration;
+		title = it->second.title;
+		return true;
+	}
+
+	if (m_bExit) {
+		return false;
+	}
+
+	m_tasks.push_back({ id, fn, size, mtime });
+
+	if (m_workers.empty()) {
+		const unsigned count = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+		for (unsigned i = 0; i < count; i++) {
+			m_workers.emplace_back(&CMediaProbe::WorkerProc, this);
+		}
+	}
+	lock.unlock();
+
+	m_cond.notify_one();
+	return false;
+}
+
+void CMediaProbe::Cancel(const std::vector<UINT>& ids)
+{
+	if (ids.empty()) {
+		return;
+	}
+
+	std::vector<UINT> sorted(ids);
+	std::sort(sorted.begin(), sorted.end());
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(), [&](const task_t& task) {
+		return std::binary_search(sorted.cbegin(), sorted.cend(), task.id);
+	}), m_tasks.end());
+}
+
+void CMediaProbe::GetResults(std::vector<result_t>& results)
+{
+	results.clear();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	results.swap(m_results);
+	m_bNotified = false;
+}
+
+void CMediaProbe::WorkerProc()
+{
+	for (;;) {
+		task_t task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait(lock, [&] { return m_bExit || !m_tasks.empty(); });
+			if (m_bExit) {
+				return;
+			}
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			m_nBusy++;
+		}
+
+		REFERENCE_TIME duration = 0;
+		CString title;
+
+		MediaInfo MI;
+		MI.Option(L"ParseSpeed", L"0");
+		if (MI.Open(task.fn.GetString())) {
+			CString str = MI.Get(Stream_General, 0, L"Duration", Info_Text, Info_Name).c_str();
+			if (!str.IsEmpty() && StrToInt64(str.GetString(), duration)) {
+				duration *= 10000LL;
+			} else {
+				duration = 0;
+			}
+			title = MI.Get(Stream_General, 0, L"Title", Info_Text, Info_Name).c_str();
+			MI.Close();
+		}
+
+		HWND hNotifyWnd = nullptr;
+		bool bSave = false;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			m_cache[GetKey(task.fn)] = { task.size, task.mtime, duration, title, ++m_nStamp };
+			m_bCacheModified = true;
+			m_nBusy--;
+
+			// don't lose the results of a long batch if the player does not exit normally
+			const ULONGLONG now = GetTickCount64();
+			if ((m_tasks.empty() && !m_nBusy) || now - m_nLastSave >= MEDIAPROBE_SAVE_INTERVAL) {
+				m_nLastSave = now;
+				bSave = true;
+			}
+
+			m_results.push_back({ task.id, duration, title });
+			if (!m_bNotified && m_hNotifyWnd) {
+				m_bNotified = true;
+				hNotifyWnd = m_hNotifyWnd;
+			}
+		}
+
+		// one message for all results collected until the owner calls GetResults()
+		if (hNotifyWnd) {
+			::PostMessageW(hNotifyWnd, m_nNotifyMsg, 0, 0);
+		}
+
+		if (bSave) {
+			SaveCache();
+		}
+	}
+}
+
+// cache file: "MPCP", version, count, then per entry
+// key length, key, size, mtime, duration, title length, title
+
+#define MEDIAPROBE_CACHE_ID      FCC('MPCP')
+#define MEDIAPROBE_CACHE_VERSION 1
+
+void CMediaProbe::LoadCache()
+{
+	if (m_cacheFile.IsEmpty()) {
+		return;
+	}
+
+	FILE* f = nullptr;
+	if (_wfopen_s(&f, m_cacheFile, L"rb") != 0 || !f) {
+		return;
+	}
+
+	auto ReadString = [&](auto& str) {
+		UINT32 len = 0;
+		if (fread(&len, sizeof(len), 1, f) != 1 || len > MAX_PATH * 128) {
+			return false;
+		}
+		std::wstring buf(len, L'\0');
+		if (len && fread(buf.data(), sizeof(wchar_t), len, f) != len) {
+			return false;
+		}
+		str = buf.c_str();
+		return true;
+	};
+
+	UINT32 header[3] = {};
+	if (fread(header, sizeof(header), 1, f) == 1 && header[0] == MEDIAPROBE_CACHE_ID && header[1] == MEDIAPROBE_CACHE_VERSION) {
+		m_cache.reserve(std::min<size_t>(header[2], MEDIAPROBE_CACHE_MAX));
+
+		for (UINT32 i = 0; i < header[2]; i++) {
+			std::wstring key;
+			cache_entry_t entry = {};
+			if (!ReadString(key)
+					|| fread(&entry.size, sizeof(entry.size), 1, f) != 1
+					|| fread(&entry.mtime, sizeof(entry.mtime), 1, f) != 1
+					|| fread(&entry.duration, sizeof(entry.duration), 1, f) != 1
+					|| !ReadString(entry.title)) {
+				break;
+			}
+			// the entries are stored from the oldest to the most recently used
+			entry.stamp = ++m_nStamp;
+			m_cache[key] = entry;
+		}
+	}
+
+	fclose(f);
+
+	m_bCacheModified = false;
+}
+
+void CMediaProbe::SaveCache()
+{
+	std::unique_lock<std::mutex> lockSave(m_mutexSave);
+
+	// the file is written from a copy, Query() is not blocked by the disk
+	CString cacheFile;
+	std::vector<std::pair<std::wstring, cache_entry_t>> entries;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (m_cacheFile.IsEmpty() || !m_bCacheModified) {
+			return;
+		}
+
+		cacheFile = m_cacheFile;
+		entries.reserve(m_cache.size());
+		for (const auto& [key, entry] : m_cache) {
+			entries.emplace_back(key, entry);
+		}
+		m_bCacheModified = false;
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+		return a.second.stamp < b.second.stamp;
+	});
+	if (entries.size() > MEDIAPROBE_CACHE_MAX) {
+		entries.erase(entries.begin(), entries.end() - MEDIAPROBE_CACHE_MAX);
+	}
+
+	FILE* f = nullptr;
+	if (_wfopen_s(&f, cacheFile, L"wb") != 0 || !f) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bCacheModified = true;
+		return;
+	}
+
+	auto WriteString = [&](LPCWSTR str, UINT32 len) {
+		fwrite(&len, sizeof(len), 1, f);
+		fwrite(str, sizeof(wchar_t), len, f);
+	};
+
+	const UINT32 header[3] = { MEDIAPROBE_CACHE_ID, MEDIAPROBE_CACHE_VERSION, (UINT32)entries.size() };
+	fwrite(header, sizeof(header), 1, f);
+
+	for (const auto& [key, entry] : entries) {
+		WriteString(key.c_str(), (UINT32)key.size());
+		fwrite(&entry.size, sizeof(entry.size), 1, f);
+		fwrite(&entry.mtime, sizeof(entry.mtime), 1, f);
+		fwrite(&entry.duration, sizeof(entry.duration), 1, f);
+		WriteString(entry.title.GetString(), (UINT32)entry.title.GetLength());
+	}
+
+	fclose(f);
+}
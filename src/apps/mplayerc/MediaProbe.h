@@ -0,0 +1,98 @@
+/*
+ * (C) 2026 see Authors.txt
+ *
+ * This file is part of MPC-BE.
+ *
+ * MPC-BE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MPC-BE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+
+// Background duration and title probing for playlist items.
+// Results are kept in a persistent cache keyed by path, size and modification time.
+// No UI dependencies: the owner is notified by posting a message and collects the results with GetResults().
+// The cache is written when a batch of files is done and at least every MEDIAPROBE_SAVE_INTERVAL during long batches.
+class CMediaProbe
+{
+public:
+	struct result_t {
+		UINT id;
+		REFERENCE_TIME duration;
+		CString title;
+	};
+
+private:
+	struct task_t {
+		UINT id;
+		CString fn;
+		UINT64 size;
+		UINT64 mtime;
+	};
+
+	struct cache_entry_t {
+		UINT64 size;
+		UINT64 mtime;
+		REFERENCE_TIME duration;
+		CString title;
+		UINT64 stamp; // last use, for trimming the cache
+	};
+
+	HWND m_hNotifyWnd = nullptr;
+	UINT m_nNotifyMsg = 0;
+	CString m_cacheFile;
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::deque<task_t> m_tasks;
+	unsigned m_nBusy = 0; // tasks being probed
+	bool m_bExit = false;
+
+	std::unordered_map<std::wstring, cache_entry_t> m_cache;
+	UINT64 m_nStamp = 0;
+	bool m_bCacheModified = false;
+	ULONGLONG m_nLastSave = 0;
+	std::mutex m_mutexSave; // serializes cache writers, taken before m_mutex
+
+	std::vector<result_t> m_results;
+	bool m_bNotified = false;
+
+	static bool GetFileInfo(const CString& fn, UINT64& size, UINT64& mtime);
+	static std::wstring GetKey(const CString& fn);
+
+	void WorkerProc();
+	void LoadCache();
+	void SaveCache();
+
+public:
+	CMediaProbe() = default;
+	~CMediaProbe();
+
+	void Start(HWND hNotifyWnd, UINT nNotifyMsg, const CString& cacheFile);
+	void Stop();
+
+	// returns true with the cached values if the file is known and unchanged,
+	// otherwise queues the file for probing and reports the result with the playlist item id later
+	bool Query(UINT id, const CString& fn, REFERENCE_TIME& duration, CString& title);
+	void Cancel(const std::vector<UINT>& ids);
+
+	void GetResults(std::vector<result_t>& results);
+};
@@ -525,16 +525,13 @@ void CPlaylistItem::AutoLoadFiles()
 
 POSITION CPlaylist::Append(CPlaylistItem& item, const bool bParseDuration)
 {
-	if (bParseDuration && !item.m_duration && !item.m_fns.empty()) {
-		const auto& fn = item.m_fns.front().GetName();
-		if (!::PathIsURLW(item.m_fns.front()) && ::PathFileExistsW(item.m_fns.front())) {
-			MediaInfo MI;
-			MI.Option(L"ParseSpeed", L"0");
-			if (MI.Open(fn.GetString())) {
-				CString duration = MI.Get(Stream_General, 0, L"Duration", Info_Text, Info_Name).c_str();
-				if (!duration.IsEmpty() && StrToInt64(duration.GetString(), item.m_duration)) {
-					item.m_duration *= 10000LL;
-				}
+	if (bParseDuration && m_pMediaProbe && !item.m_duration && !item.m_fns.empty()) {
+		const auto& fi = item.m_fns.front();
+		if (!::PathIsURLW(fi)) {
+			// unknown files are probed in the background, see CPlayerPlaylistBar::OnMediaProbeDone()
+			CString title;
+			if (m_pMediaProbe->Query(item.m_id, fi.GetName(), item.m_duration, title) && item.m_label.IsEmpty()) {
+				item.m_label = title;
 			}
 		}
 	}
@@ -544,6 +541,15 @@ POSITION CPlaylist::Append(CPlaylistItem& item, const bool bParseDuration)
 
 bool CPlaylist::RemoveAll()
 {
+	if (m_pMediaProbe) {
+		std::vector<UINT> ids;
+		ids.reserve(GetCount());
+		for (POSITION pos = GetHeadPosition(); pos; ) {
+			ids.push_back(GetNext(pos).m_id);
+		}
+		m_pMediaProbe->Cancel(ids);
+	}
+
 	__super::RemoveAll();
 	bool bWasPlaying = (m_pos != nullptr);
 	m_pos = nullptr;
@@ -806,6 +812,8 @@ CPlayerPlaylistBar::CPlayerPlaylistBar(CMainFrame* pMainFrame)
 
 CPlayerPlaylistBar::~CPlayerPlaylistBar()
 {
+	m_MediaProbe.Stop();
+
 	TEnsureVisible(m_nCurPlayListIndex); // save selected tab visible
 	SavePlaylist();
 	TSaveSettings();
@@ -865,6 +873,12 @@ BOOL CPlayerPlaylistBar::Create(CWnd* pParentWnd, UINT defDockBarID)
 	TCalcLayout();
 	TCalcREdit();
 
+	CString cacheFile;
+	if (AfxGetMyApp()->GetAppSavePath(cacheFile)) {
+		cacheFile += L"mediaprobe.cache";
+	}
+	m_MediaProbe.Start(m_hWnd, WM_MEDIAPROBE_DONE, cacheFile);
+
 	return TRUE;
 }
 
@@ -2602,6 +2616,7 @@ BEGIN_MESSAGE_MAP(CPlayerPlaylistBar, CSizingControlBarG)
 	ON_NOTIFY(LVN_ENDLABELEDITW, IDC_PLAYLIST, OnLvnEndlabeleditList)
 	ON_WM_MEASUREITEM()
 	ON_WM_SETFOCUS()
+	ON_MESSAGE(WM_MEDIAPROBE_DONE, OnMediaProbeDone)
 END_MESSAGE_MAP()
 
 // CPlayerPlaylistBar message handlers
@@ -4165,7 +4180,7 @@ void CPlayerPlaylistBar::TOnMenu(bool bUnderCursor)
 					tab.id = GetNextId();
 					m_tabs.insert(m_tabs.begin() + m_nCurPlayListIndex + 1, tab);
 
-					CPlaylist* pl = DNew CPlaylist;
+					CPlaylist* pl = DNew CPlaylist(&m_MediaProbe);
 					m_pls.insert(m_pls.begin() + m_nCurPlayListIndex + 1, pl);
 
 					SavePlaylist(); // save current playlist
@@ -4202,7 +4217,7 @@ void CPlayerPlaylistBar::TOnMenu(bool bUnderCursor)
 					tab.id = GetNextId();
 					m_tabs.insert(m_tabs.begin() + m_nCurPlayListIndex + 1, tab);
 
-					CPlaylist* pl = DNew CPlaylist;
+					CPlaylist* pl = DNew CPlaylist(&m_MediaProbe);
 					m_pls.insert(m_pls.begin() + m_nCurPlayListIndex + 1, pl);
 
 					SavePlaylist(); //save current playlist
@@ -4608,7 +4623,7 @@ void CPlayerPlaylistBar::TGetSettings()
 		m_tabs.push_back(tab);
 
 		// add playlist
-		CPlaylist* pl = DNew CPlaylist;
+		CPlaylist* pl = DNew CPlaylist(&m_MediaProbe);
 		m_pls.push_back(pl);
 	}
 
@@ -4622,7 +4637,7 @@ void CPlayerPlaylistBar::TGetSettings()
 		m_tabs.push_back(tab);
 
 		// add playlist
-		CPlaylist* pl = DNew CPlaylist;
+		CPlaylist* pl = DNew CPlaylist(&m_MediaProbe);
 		m_pls.push_back(pl);
 	}
 
@@ -4940,3 +4955,49 @@ void CPlayerPlaylistBar::PasteFromClipboard()
 		}
 	}
 }
+
+LRESULT CPlayerPlaylistBar::OnMediaProbeDone(WPARAM wParam, LPARAM lParam)
+{
+	std::vector<CMediaProbe::result_t> results;
+	m_MediaProbe.GetResults(results);
+	if (results.empty()) {
+		return 0;
+	}
+
+	std::unordered_map<UINT, const CMediaProbe::result_t*> resultsMap;
+	resultsMap.reserve(results.size());
+	for (const auto& result : results) {
+		resultsMap.emplace(result.id, &result);
+	}
+
+	for (size_t i = 0; i < m_pls.size() && !resultsMap.empty(); i++) {
+		const bool bCurrent = (i == m_nCurPlayListIndex);
+
+		POSITION pos = m_pls[i]->GetHeadPosition();
+		for (int idx = 0; pos && !resultsMap.empty(); idx++) {
+			CPlaylistItem& pli = m_pls[i]->GetNext(pos);
+
+			const auto it = resultsMap.find(pli.m_id);
+			if (it == resultsMap.end()) {
+				continue;
+			}
+			const auto& result = *it->second;
+			resultsMap.erase(it);
+
+			if (pli.m_label.IsEmpty() && !result.title.IsEmpty()) {
+				pli.m_label = result.title;
+				if (bCurrent && idx < m_list.GetItemCount()) {
+					m_list.SetItemText(idx, COL_NAME, pli.GetLabel(0));
+				}
+			}
+			if (!pli.m_duration && result.duration > 0) {
+				pli.m_duration = result.duration;
+				if (bCurrent && idx < m_list.GetItemCount()) {
+					m_list.SetItemText(idx, COL_TIME, pli.GetLabel(1));
+				}
+			}
+		}
+	}
+
+	return 0;
+}
@@ -25,6 +25,7 @@
 #include "PlayerListCtrl.h"
 #include "controls/ColorEdit.h"
 #include "DSUtil/CUE.h"
+#include "MediaProbe.h"
 
 typedef std::vector<Chapters> ChaptersList;
 class CFileItem
@@ -148,9 +149,12 @@ class CPlaylist : public CList<CPlaylistItem>
 {
 protected:
 	POSITION m_pos = nullptr;
+	CMediaProbe* m_pMediaProbe = nullptr;
 
 public:
-	CPlaylist() = default;
+	CPlaylist(CMediaProbe* pMediaProbe = nullptr)
+		: m_pMediaProbe(pMediaProbe)
+	{}
 	~CPlaylist() = default;
 
 	POSITION Append(CPlaylistItem& item, const bool bParseDuration);
@@ -196,6 +200,8 @@ private:
 	CImageList m_fakeImageList;
 	CPlayerListCtrl m_list;
 
+	CMediaProbe m_MediaProbe;
+
 	int m_nTimeColWidth;
 	void ResizeListColumn();
 
@@ -479,6 +485,7 @@ public:
 	afx_msg void OnLvnEndlabeleditList(NMHDR* pNMHDR, LRESULT* pResult);
 	afx_msg void OnMeasureItem(int nIDCtl, LPMEASUREITEMSTRUCT lpMeasureItemStruct);
 	afx_msg void OnSetFocus(CWnd* pOldWnd);
+	afx_msg LRESULT OnMediaProbeDone(WPARAM wParam, LPARAM lParam);
 
 	virtual void Invalidate() { m_list.Invalidate(); }
 
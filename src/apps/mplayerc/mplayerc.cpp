@@ -1303,6 +1303,7 @@ int CMPlayerCApp::ExitInstance()
 		} else {
 			m_s.SaveSettings();
 		}
+		m_HistoryFile.Compact();
 	}
 
 	OleUninitialize();
@@ -609,19 +609,47 @@ UINT64 Cluster::Size(bool fWithHeader)
 	len += PrevSize.Size();
 	len += BlockGroups.Size();
 	if (fWithHeader) {
-		len += HeaderSize(len);
+		len += CID::Size() + 8; // the length is always written as 8 bytes, see Write()
 	}
 	return len;
 }
 
 HRESULT Cluster::Write(IStream* pStream)
 {
-	HeaderWrite(pStream);
+	// write the children in a single pass and patch the length afterwards
+	HRESULT hr = CID::Write(pStream);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	LARGE_INTEGER zero = {};
+	ULARGE_INTEGER lenpos = {};
+	pStream->Seek(zero, STREAM_SEEK_CUR, &lenpos);
+	BYTE len[8] = { 0x01 };
+	pStream->Write(len, sizeof(len), nullptr);
+
 	TimeCode.Write(pStream);
 	Position.Write(pStream);
 	PrevSize.Write(pStream);
-	BlockGroups.Write(pStream);
-	return S_OK;
+	hr = BlockGroups.Write(pStream);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	ULARGE_INTEGER endpos = {};
+	pStream->Seek(zero, STREAM_SEEK_CUR, &endpos);
+
+	UINT64 val = endpos.QuadPart - lenpos.QuadPart - sizeof(len);
+	for (int i = 7; i > 0; i--, val >>= 8) {
+		len[i] = (BYTE)val;
+	}
+
+	LARGE_INTEGER pos;
+	pos.QuadPart = lenpos.QuadPart;
+	pStream->Seek(pos, STREAM_SEEK_SET, nullptr);
+	pStream->Write(len, sizeof(len), nullptr);
+	pos.QuadPart = endpos.QuadPart;
+	return pStream->Seek(pos, STREAM_SEEK_SET, nullptr);
 }
 
 BlockGroup::BlockGroup(DWORD id)
@@ -723,79 +751,53 @@ Cue::Cue(DWORD id)
 {
 }
 
-UINT64 Cue::Size(bool fWithHeader)
+UINT64 Cue::CueTrackPositionSize(const CuePoint& cp)
 {
 	UINT64 len = 0;
-	len += CuePoints.Size();
-	if (fWithHeader) {
-		len += HeaderSize(len);
+	len += CUInt(0xF7).Set(cp.CueTrack).Size();
+	len += CUInt(0xF1).Set(cp.CueClusterPosition).Size();
+	if (cp.bCueBlockNumber) {
+		len += CUInt(0x5387).Set(cp.CueBlockNumber).Size();
 	}
 	return len;
 }
 
-HRESULT Cue::Write(IStream* pStream)
+UINT64 Cue::CuePointSize(const CuePoint& cp)
 {
-	HeaderWrite(pStream);
-	CuePoints.Write(pStream);
-	return S_OK;
-}
-
-CuePoint::CuePoint(DWORD id)
-	: CID(id)
-	, CueTime(0xB3)
-{
-}
-
-UINT64 CuePoint::Size(bool fWithHeader)
-{
-	UINT64 len = 0;
-	len += CueTime.Size();
-	len += CueTrackPositions.Size();
-	if (fWithHeader) {
-		len += HeaderSize(len);
-	}
+	UINT64 len = CueTrackPositionSize(cp);
+	len += CID(0xB7).Size() + CLength(len).Size();
+	len += CUInt(0xB3).Set(cp.CueTime).Size();
 	return len;
 }
 
-HRESULT CuePoint::Write(IStream* pStream)
-{
-	HeaderWrite(pStream);
-	CueTime.Write(pStream);
-	CueTrackPositions.Write(pStream);
-	return S_OK;
-}
-
-CueTrackPosition::CueTrackPosition(DWORD id)
-	: CID(id)
-	, CueTrack(0xF7)
-	, CueClusterPosition(0xF1)
-	, CueBlockNumber(0x5387)
-	, CueCodecState(0xEA)
-{
-}
-
-UINT64 CueTrackPosition::Size(bool fWithHeader)
+UINT64 Cue::Size(bool fWithHeader)
 {
 	UINT64 len = 0;
-	len += CueTrack.Size();
-	len += CueClusterPosition.Size();
-	len += CueBlockNumber.Size();
-	len += CueCodecState.Size();
-	//len += CueReferences.Size();
+	for (const auto& cp : CuePoints) {
+		const UINT64 cplen = CuePointSize(cp);
+		len += CID(0xBB).Size() + CLength(cplen).Size() + cplen;
+	}
 	if (fWithHeader) {
 		len += HeaderSize(len);
 	}
 	return len;
 }
 
-HRESULT CueTrackPosition::Write(IStream* pStream)
+HRESULT Cue::Write(IStream* pStream)
 {
 	HeaderWrite(pStream);
-	CueTrack.Write(pStream);
-	CueClusterPosition.Write(pStream);
-	CueBlockNumber.Write(pStream);
-	CueCodecState.Write(pStream);
-	//CueReferences.Write(pStream);
+	for (const auto& cp : CuePoints) {
+		CID(0xBB).Write(pStream);
+		CLength(CuePointSize(cp)).Write(pStream);
+		CUInt(0xB3).Set(cp.CueTime).Write(pStream);
+		CID(0xB7).Write(pStream);
+		CLength(CueTrackPositionSize(cp)).Write(pStream);
+		CUInt(0xF7).Set(cp.CueTrack).Write(pStream);
+		CUInt(0xF1).Set(cp.CueClusterPosition).Write(pStream);
+		if (cp.bCueBlockNumber) {
+			CUInt(0x5387).Set(cp.CueBlockNumber).Write(pStream);
+		}
+	}
 	return S_OK;
 }
 
@@ -923,3 +925,195 @@ HRESULT Void::Write(IStream* pStream)
 
 	return S_OK;
 }
+
+//
+
+CBufferedStream::CBufferedStream(IStream* pStream, ULONG bufferSize)
+	: CUnknown(L"CBufferedStream", nullptr)
+	, m_pStream(pStream)
+	, m_buffer(new(std::nothrow) BYTE[bufferSize])
+	, m_bufferSize(m_buffer ? bufferSize : 0)
+{
+}
+
+CBufferedStream::~CBufferedStream()
+{
+	Flush();
+}
+
+STDMETHODIMP CBufferedStream::NonDelegatingQueryInterface(REFIID riid, void** ppv)
+{
+	CheckPointer(ppv, E_POINTER);
+
+	return
+		QI(IStream)
+		QI(ISequentialStream)
+		__super::NonDelegatingQueryInterface(riid, ppv);
+}
+
+HRESULT CBufferedStream::Flush()
+{
+	if (!m_bufferLen) {
+		return S_OK;
+	}
+
+	LARGE_INTEGER pos;
+	pos.QuadPart = m_bufferPos;
+	HRESULT hr = m_pStream->Seek(pos, STREAM_SEEK_SET, nullptr);
+	if (SUCCEEDED(hr)) {
+		hr = m_pStream->Write(m_buffer.get(), m_bufferLen, nullptr);
+		m_nStreamWrites++;
+	}
+	m_bufferLen = 0;
+
+	return hr;
+}
+
+// ISequentialStream
+
+STDMETHODIMP CBufferedStream::Read(void* pv, ULONG cb, ULONG* pcbRead)
+{
+	HRESULT hr = Flush();
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	LARGE_INTEGER pos;
+	pos.QuadPart = m_pos;
+	m_pStream->Seek(pos, STREAM_SEEK_SET, nullptr);
+	ULONG cbRead = 0;
+	hr = m_pStream->Read(pv, cb, &cbRead);
+	m_pos += cbRead;
+	if (pcbRead) {
+		*pcbRead = cbRead;
+	}
+
+	return hr;
+}
+
+STDMETHODIMP CBufferedStream::Write(const void* pv, ULONG cb, ULONG* pcbWritten)
+{
+	CheckPointer(pv, STG_E_INVALIDPOINTER);
+
+	m_nWrites++;
+
+	if (m_bufferLen && (m_pos < m_bufferPos || m_pos > m_bufferPos + m_bufferLen || m_pos + cb > m_bufferPos + m_bufferSize)) {
+		HRESULT hr = Flush();
+		if (FAILED(hr)) {
+			return hr;
+		}
+	}
+
+	if (cb >= m_bufferSize) {
+		LARGE_INTEGER pos;
+		pos.QuadPart = m_pos;
+		m_pStream->Seek(pos, STREAM_SEEK_SET, nullptr);
+		ULONG cbWritten = 0;
+		HRESULT hr = m_pStream->Write(pv, cb, &cbWritten);
+		m_nStreamWrites++;
+		m_pos += cbWritten;
+		if (pcbWritten) {
+			*pcbWritten = cbWritten;
+		}
+		return hr;
+	}
+
+	if (!m_bufferLen) {
+		m_bufferPos = m_pos;
+	}
+
+	const ULONG offset = (ULONG)(m_pos - m_bufferPos);
+	memcpy(m_buffer.get() + offset, pv, cb);
+	m_bufferLen = std::max(m_bufferLen, offset + cb);
+	m_pos += cb;
+
+	if (pcbWritten) {
+		*pcbWritten = cb;
+	}
+
+	return S_OK;
+}
+
+// IStream
+
+STDMETHODIMP CBufferedStream::Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER* plibNewPosition)
+{
+	switch (dwOrigin) {
+		case STREAM_SEEK_SET:
+			m_pos = dlibMove.QuadPart;
+			break;
+		case STREAM_SEEK_CUR:
+			m_pos += dlibMove.QuadPart;
+			break;
+		case STREAM_SEEK_END: {
+			HRESULT hr = Flush();
+			if (FAILED(hr)) {
+				return hr;
+			}
+			ULARGE_INTEGER pos = {};
+			hr = m_pStream->Seek(dlibMove, STREAM_SEEK_END, &pos);
+			if (FAILED(hr)) {
+				return hr;
+			}
+			m_pos = pos.QuadPart;
+			break;
+		}
+		default:
+			return STG_E_INVALIDFUNCTION;
+	}
+
+	if (plibNewPosition) {
+		plibNewPosition->QuadPart = m_pos;
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP CBufferedStream::SetSize(ULARGE_INTEGER libNewSize)
+{
+	HRESULT hr = Flush();
+	return SUCCEEDED(hr) ? m_pStream->SetSize(libNewSize) : hr;
+}
+
+STDMETHODIMP CBufferedStream::CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead, ULARGE_INTEGER* pcbWritten)
+{
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP CBufferedStream::Commit(DWORD grfCommitFlags)
+{
+	HRESULT hr = Flush();
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	// the output stream may not support transactions, the data is already written
+	m_pStream->Commit(grfCommitFlags);
+	return S_OK;
+}
+
+STDMETHODIMP CBufferedStream::Revert()
+{
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP CBufferedStream::LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType)
+{
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP CBufferedStream::UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType)
+{
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP CBufferedStream::Stat(STATSTG* pstatstg, DWORD grfStatFlag)
+{
+	HRESULT hr = Flush();
+	return SUCCEEDED(hr) ? m_pStream->Stat(pstatstg, grfStatFlag) : hr;
+}
+
+STDMETHODIMP CBufferedStream::Clone(IStream** ppstm)
+{
+	return E_NOTIMPL;
+}
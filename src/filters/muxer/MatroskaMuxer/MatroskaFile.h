@@ -328,32 +328,22 @@ namespace MatroskaWriter
 		HRESULT Write(IStream* pStream);
 	};*/
 
-	class CueTrackPosition : public CID
-	{
-	public:
-		CUInt CueTrack, CueClusterPosition, CueBlockNumber, CueCodecState;
-		//CNode<CueReference> CueReferences;
-
-		CueTrackPosition(DWORD id = 0xB7);
-		UINT64 Size(bool fWithHeader = true);
-		HRESULT Write(IStream* pStream);
-	};
-
-	class CuePoint : public CID
-	{
-	public:
-		CUInt CueTime;
-		CNode<CueTrackPosition> CueTrackPositions;
-
-		CuePoint(DWORD id = 0xBB);
-		UINT64 Size(bool fWithHeader = true);
-		HRESULT Write(IStream* pStream);
+	// CuePoint with a single CueTrackPositions, serialized by Cue without per-element objects
+	struct CuePoint {
+		UINT64 CueTime;
+		UINT64 CueTrack;
+		UINT64 CueClusterPosition;
+		UINT64 CueBlockNumber;
+		bool   bCueBlockNumber; // CueBlockNumber is set
 	};
 
 	class Cue : public CID
 	{
+		UINT64 CueTrackPositionSize(const CuePoint& cp);
+		UINT64 CuePointSize(const CuePoint& cp);
+
 	public:
-		CNode<CuePoint> CuePoints;
+		std::vector<CuePoint> CuePoints;
 
 		Cue(DWORD id = 0x1C53BB6B);
 		UINT64 Size(bool fWithHeader = true);
@@ -419,4 +409,50 @@ namespace MatroskaWriter
 		UINT64 Size(bool fWithHeader = true);
 		HRESULT Write(IStream* pStream);
 	};
+
+	// Write-combining IStream wrapper.
+	// Element writes are collected in a memory window and passed to the output stream in large chunks.
+	// Seeking back inside the window (size back-patching) does not touch the output stream.
+	class CBufferedStream
+		: public CUnknown
+		, public IStream
+	{
+		CComPtr<IStream> m_pStream;
+
+		std::unique_ptr<BYTE[]> m_buffer;
+		const ULONG m_bufferSize;
+		ULONGLONG m_bufferPos = 0; // stream position of the first buffered byte
+		ULONG m_bufferLen = 0;
+		ULONGLONG m_pos = 0;
+
+		UINT64 m_nWrites = 0;
+		UINT64 m_nStreamWrites = 0;
+
+		HRESULT Flush();
+
+	public:
+		CBufferedStream(IStream* pStream, ULONG bufferSize = 4 * 1024 * 1024);
+		~CBufferedStream();
+
+		UINT64 GetWriteCount() const { return m_nWrites; }
+		UINT64 GetStreamWriteCount() const { return m_nStreamWrites; }
+
+		DECLARE_IUNKNOWN;
+		STDMETHODIMP NonDelegatingQueryInterface(REFIID riid, void** ppv);
+
+		// ISequentialStream
+		STDMETHODIMP Read(void* pv, ULONG cb, ULONG* pcbRead);
+		STDMETHODIMP Write(const void* pv, ULONG cb, ULONG* pcbWritten);
+
+		// IStream
+		STDMETHODIMP Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER* plibNewPosition);
+		STDMETHODIMP SetSize(ULARGE_INTEGER libNewSize);
+		STDMETHODIMP CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead, ULARGE_INTEGER* pcbWritten);
+		STDMETHODIMP Commit(DWORD grfCommitFlags);
+		STDMETHODIMP Revert();
+		STDMETHODIMP LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType);
+		STDMETHODIMP UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType);
+		STDMETHODIMP Stat(STATSTG* pstatstg, DWORD grfStatFlag);
+		STDMETHODIMP Clone(IStream** ppstm);
+	};
 }
@@ -161,6 +161,12 @@ STDMETHODIMP CMatroskaMuxerFilter::Stop()
 
 	HRESULT hr;
 
+	{
+		std::unique_lock<std::mutex> lock(m_mutexQueue);
+		m_bAbort = true;
+	}
+	m_condData.notify_all();
+
 	if (FAILED(hr = __super::Stop())) {
 		return hr;
 	}
@@ -183,6 +189,10 @@ STDMETHODIMP CMatroskaMuxerFilter::Pause()
 	}
 
 	if (fs == State_Stopped && m_pOutput) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutexQueue);
+			m_bAbort = false;
+		}
 		CAMThread::Create();
 		CallWorker(CMD_RUN);
 	}
@@ -200,9 +210,49 @@ STDMETHODIMP CMatroskaMuxerFilter::Run(REFERENCE_TIME tStart)
 		return hr;
 	}
 
+	{
+		std::unique_lock<std::mutex> lock(m_mutexQueue);
+	}
+	m_condData.notify_all();
+
 	return hr;
 }
 
+// interleaver
+
+static bool QueueFrontGreater(const CMatroskaMuxerInputPin* a, const CMatroskaMuxerInputPin* b)
+{
+	const auto& ba = a->m_blocks.front()->Block;
+	const auto& bb = b->m_blocks.front()->Block;
+	return ba.TimeCode > bb.TimeCode || ba.TimeCode == bb.TimeCode && ba.TrackNumber > bb.TrackNumber;
+}
+
+void CMatroskaMuxerFilter::UpdateQueueState(CMatroskaMuxerInputPin* pPin)
+{
+	const bool bRunning = pPin->m_fActive && !pPin->m_fEndOfStreamReceived;
+	if (bRunning != pPin->m_bRunning) {
+		pPin->m_bRunning = bRunning;
+		bRunning ? m_nRunningPins++ : m_nRunningPins--;
+	}
+
+	// sparse tracks (subtitles) never hold back the other tracks
+	const bool bBlocking = bRunning && pPin->m_blocks.empty()
+						   && pPin->GetTrackEntry() && pPin->GetTrackEntry()->TrackType != TrackEntry::TypeSubtitle;
+	if (bBlocking != pPin->m_bBlocking) {
+		pPin->m_bBlocking = bBlocking;
+		bBlocking ? m_nBlockingPins++ : m_nBlockingPins--;
+	}
+}
+
+void CMatroskaMuxerFilter::RemoveFromQueueHeap(CMatroskaMuxerInputPin* pPin)
+{
+	auto it = std::find(m_QueueHeap.begin(), m_QueueHeap.end(), pPin);
+	if (it != m_QueueHeap.end()) {
+		m_QueueHeap.erase(it);
+		std::make_heap(m_QueueHeap.begin(), m_QueueHeap.end(), QueueFrontGreater);
+	}
+}
+
 // IAMFilterMiscFlags
 
 STDMETHODIMP_(ULONG) CMatroskaMuxerFilter::GetMiscFlags()
@@ -331,6 +381,16 @@ STDMETHODIMP CMatroskaMuxerFilter::CorrectTimeOffset(bool fNegative, bool fPosit
 	return S_OK;
 }
 
+STDMETHODIMP CMatroskaMuxerFilter::GetWriteStats(UINT64* pElementWrites, UINT64* pStreamWrites)
+{
+	CheckPointer(pElementWrites, E_POINTER);
+	CheckPointer(pStreamWrites, E_POINTER);
+
+	*pElementWrites = m_nElementWrites;
+	*pStreamWrites  = m_nStreamWrites;
+	return S_OK;
+}
+
 //
 
 ULONGLONG GetStreamPosition(IStream* pStream)
@@ -354,9 +414,9 @@ ULONGLONG SetStreamPosition(IStream* pStream, ULONGLONG seekpos)
 #pragma warning(disable: 4702)
 DWORD CMatroskaMuxerFilter::ThreadProc()
 {
-	CComQIPtr<IStream> pStream;
+	CComQIPtr<IStream> pOutStream;
 
-	if (!m_pOutput || !(pStream = m_pOutput->GetConnected())) {
+	if (!m_pOutput || !(pOutStream = m_pOutput->GetConnected())) {
 		for (;;) {
 			DWORD cmd = GetRequest();
 			if (cmd == CMD_EXIT) {
@@ -369,6 +429,9 @@ DWORD CMatroskaMuxerFilter::ThreadProc()
 		}
 	}
 
+	CBufferedStream* pBufferedStream = DNew CBufferedStream(pOutStream);
+	CComPtr<IStream> pStream = pBufferedStream;
+
 	REFERENCE_TIME rtDur = 0;
 	GetDuration(&rtDur);
 
@@ -485,55 +548,36 @@ DWORD CMatroskaMuxerFilter::ThreadProc()
 				INT64 lastcuetimecode = (INT64) - 1;
 				UINT64 nBlocksInCueTrack = 0;
 
-				while (!CheckRequest(nullptr)) {
-					if (m_State == State_Paused) {
-						Sleep(10);
-						continue;
-					}
-
-					int nPinsGotSomething = 0, nPinsNeeded = 0;
-					CMatroskaMuxerInputPin* pPin = nullptr;
-					REFERENCE_TIME rtMin = _I64_MAX;
-
-					auto it = pActivePins.begin();
-					while (it != pActivePins.end()) {
-						CMatroskaMuxerInputPin* pTmp = *it;
+				for (;;) {
+					std::unique_ptr<BlockGroup> b;
 
-						CAutoLock cAutoLock(&pTmp->m_csQueue);
+					{
+						std::unique_lock<std::mutex> lock(m_mutexQueue);
+						m_condData.wait(lock, [&] {
+							return m_bAbort || m_State == State_Running && (m_nRunningPins == 0 || !m_QueueHeap.empty() && m_nBlockingPins == 0);
+						});
 
-						if (pTmp->m_blocks.empty() && pTmp->m_fEndOfStreamReceived) {
-							pActivePins.erase(it++);
-							continue;
-						} else {
-							it++;
+						if (m_bAbort || m_QueueHeap.empty()) {
+							break;
 						}
 
-						if (pTmp->GetTrackEntry()->TrackType != TrackEntry::TypeSubtitle) {
-							nPinsNeeded++;
-						}
+						std::pop_heap(m_QueueHeap.begin(), m_QueueHeap.end(), QueueFrontGreater);
+						CMatroskaMuxerInputPin* pPin = m_QueueHeap.back();
+						m_QueueHeap.pop_back();
 
-						if (!pTmp->m_blocks.empty()) {
-							if (pTmp->GetTrackEntry()->TrackType != TrackEntry::TypeSubtitle) {
-								nPinsGotSomething++;
-							}
+						const bool bWasFull = pPin->m_blocks.size() >= MAXBLOCKS;
+						b = std::move(pPin->m_blocks.front());
+						pPin->m_blocks.pop_front();
 
-							if (!pTmp->m_blocks.empty()) {
-								REFERENCE_TIME rt = pTmp->m_blocks.front()->Block.TimeCode;
-								if (rt < rtMin) {
-									rtMin = rt;
-									pPin = pTmp;
-								}
-							}
+						if (!pPin->m_blocks.empty()) {
+							m_QueueHeap.push_back(pPin);
+							std::push_heap(m_QueueHeap.begin(), m_QueueHeap.end(), QueueFrontGreater);
 						}
-					}
-
-					if (pActivePins.empty()) {
-						break;
-					}
+						UpdateQueueState(pPin);
 
-					if (!pPin || nPinsNeeded > nPinsGotSomething || !pPin && nPinsGotSomething == 0) {
-						Sleep(1);
-						continue;
+						if (bWasFull) {
+							pPin->m_condSpace.notify_one();
+						}
 					}
 
 					if (!fTracksWritten) {
@@ -559,16 +603,6 @@ DWORD CMatroskaMuxerFilter::ThreadProc()
 						fTracksWritten = true;
 					}
 
-					ASSERT(pPin);
-
-					std::unique_ptr<BlockGroup> b;
-
-					{
-						CAutoLock cAutoLock(&pPin->m_csQueue);
-						b = std::move(pPin->m_blocks.front());
-						pPin->m_blocks.pop_front();
-					}
-
 					if (b) {
 						if (fFirstBlock) {
 							if (b->Block.TimeCode < 0 && m_fNegative || b->Block.TimeCode > 0 && m_fPositive) {
@@ -614,16 +648,13 @@ DWORD CMatroskaMuxerFilter::ThreadProc()
 						if (b->ReferenceBlock == 0 && b->Block.TrackNumber == TrackNumber) {
 							ULONGLONG clusterpos = GetStreamPosition(pStream) - segpos;
 							if (lastcueclusterpos != clusterpos || lastcuetimecode + 1000 < b->Block.TimeCode) {
-								std::unique_ptr<CueTrackPosition> ctp(DNew CueTrackPosition());
-								ctp->CueTrack.Set(b->Block.TrackNumber);
-								ctp->CueClusterPosition.Set(clusterpos);
-								if (!c.BlockGroups.empty()) {
-									ctp->CueBlockNumber.Set(nBlocksInCueTrack);
-								}
-								std::unique_ptr<CuePoint> cp(DNew CuePoint());
-								cp->CueTime.Set(b->Block.TimeCode);
-								cp->CueTrackPositions.emplace_back(std::move(ctp));
-								cue.CuePoints.emplace_back(std::move(cp));
+								cue.CuePoints.push_back({
+									(UINT64)b->Block.TimeCode,
+									b->Block.TrackNumber,
+									clusterpos,
+									nBlocksInCueTrack,
+									!c.BlockGroups.empty()
+								});
 								lastcueclusterpos = clusterpos;
 								lastcuetimecode = b->Block.TimeCode;
 							}
@@ -692,6 +723,12 @@ DWORD CMatroskaMuxerFilter::ThreadProc()
 
 				// TODO: write some tags
 
+				pStream->Commit(STGC_DEFAULT);
+
+				m_nElementWrites = pBufferedStream->GetWriteCount();
+				m_nStreamWrites  = pBufferedStream->GetStreamWriteCount();
+				DLog(L"CMatroskaMuxerFilter::ThreadProc() : %I64u element writes, %I64u output stream writes", (UINT64)m_nElementWrites, (UINT64)m_nStreamWrites);
+
 				m_pOutput->DeliverEndOfStream();
 
 				break;
@@ -1152,17 +1189,32 @@ HRESULT CMatroskaMuxerInputPin::CompleteConnect(IPin* pPin)
 
 HRESULT CMatroskaMuxerInputPin::Active()
 {
-	m_fActive = true;
+	auto pFilter = static_cast<CMatroskaMuxerFilter*>(m_pFilter);
+
 	m_rtLastStart = m_rtLastStop = -1;
-	m_fEndOfStreamReceived = false;
+	{
+		std::unique_lock<std::mutex> lock(pFilter->m_mutexQueue);
+		m_fActive = true;
+		m_fEndOfStreamReceived = false;
+		pFilter->UpdateQueueState(this);
+	}
 	return __super::Active();
 }
 
 HRESULT CMatroskaMuxerInputPin::Inactive()
 {
-	m_fActive = false;
-	CAutoLock cAutoLock(&m_csQueue);
-	m_blocks.clear();
+	auto pFilter = static_cast<CMatroskaMuxerFilter*>(m_pFilter);
+
+	{
+		std::unique_lock<std::mutex> lock(pFilter->m_mutexQueue);
+		m_fActive = false;
+		pFilter->RemoveFromQueueHeap(this);
+		m_blocks.clear();
+		pFilter->UpdateQueueState(this);
+	}
+	m_condSpace.notify_all();
+	pFilter->m_condData.notify_all();
+
 	m_pVorbisHdrs.clear();
 	return __super::Inactive();
 }
@@ -1192,19 +1244,15 @@ STDMETHODIMP CMatroskaMuxerInputPin::Receive(IMediaSample* pSample)
 
 	CAutoLock cAutoLock(&m_csReceive);
 
-	while (m_fActive) {
-		{
-			CAutoLock cAutoLock2(&m_csQueue);
-			if (m_blocks.size() < MAXBLOCKS) {
-				break;
-			}
-		}
+	auto pFilter = static_cast<CMatroskaMuxerFilter*>(m_pFilter);
 
-		Sleep(1);
-	}
+	{
+		std::unique_lock<std::mutex> lock(pFilter->m_mutexQueue);
+		m_condSpace.wait(lock, [&] { return !m_fActive || m_blocks.size() < MAXBLOCKS; });
 
-	if (!m_fActive) {
-		return S_FALSE;
+		if (!m_fActive) {
+			return S_FALSE;
+		}
 	}
 
 	HRESULT hr;
@@ -1309,12 +1357,29 @@ STDMETHODIMP CMatroskaMuxerInputPin::Receive(IMediaSample* pSample)
 	memcpy(data->data(), pData, inputLen);
 	b->Block.BlockData.emplace_back(std::move(data));
 
-	CAutoLock cAutoLock2(&m_csQueue);
-	m_blocks.emplace_back(std::move(b)); // TODO: lacing for audio
-
 	m_rtLastStart = rtStart;
 	m_rtLastStop = rtStop;
 
+	{
+		std::unique_lock<std::mutex> lock(pFilter->m_mutexQueue);
+		if (!m_fActive) {
+			return S_FALSE;
+		}
+
+		const bool bWasEmpty = m_blocks.empty();
+		m_blocks.emplace_back(std::move(b)); // TODO: lacing for audio
+
+		if (!bWasEmpty) {
+			// the muxer only needs to know when the front of the queue changes
+			return S_OK;
+		}
+
+		pFilter->m_QueueHeap.push_back(this);
+		std::push_heap(pFilter->m_QueueHeap.begin(), pFilter->m_QueueHeap.end(), QueueFrontGreater);
+		pFilter->UpdateQueueState(this);
+	}
+	pFilter->m_condData.notify_one();
+
 	return S_OK;
 }
 
@@ -1326,9 +1391,14 @@ STDMETHODIMP CMatroskaMuxerInputPin::EndOfStream()
 		return hr;
 	}
 
-	CAutoLock cAutoLock(&m_csQueue);
+	auto pFilter = static_cast<CMatroskaMuxerFilter*>(m_pFilter);
 
-	m_fEndOfStreamReceived = true;
+	{
+		std::unique_lock<std::mutex> lock(pFilter->m_mutexQueue);
+		m_fEndOfStreamReceived = true;
+		pFilter->UpdateQueueState(this);
+	}
+	pFilter->m_condData.notify_one();
 
 	return hr;
 }
@@ -21,6 +21,10 @@
 
 #pragma once
 
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include "MatroskaFile.h"
 
 #define MAXCLUSTERTIME 1000
@@ -49,9 +53,12 @@ public:
 
 	REFERENCE_TIME m_rtDur;
 
-	CCritSec m_csQueue;
-	std::list<std::unique_ptr<MatroskaWriter::BlockGroup>> m_blocks;
+	// protected by CMatroskaMuxerFilter::m_mutexQueue
+	std::deque<std::unique_ptr<MatroskaWriter::BlockGroup>> m_blocks;
+	std::condition_variable m_condSpace;
 	bool m_fEndOfStreamReceived;
+	bool m_bBlocking = false; // non-sparse track without queued blocks, the muxer waits for it
+	bool m_bRunning  = false; // active and no end of stream yet
 
 	HRESULT CheckMediaType(const CMediaType* pmt);
 	HRESULT BreakConnect();
@@ -87,6 +94,9 @@ interface __declspec(uuid("38E2D43D-915D-493C-B373-888DB16EE3DC"))
 IMatroskaMuxer :
 public IUnknown {
 	STDMETHOD(CorrectTimeOffset)(bool fNegative, bool fPositive) PURE;
+	// element writes and output stream writes of the last completed file, with write-combining
+	// the second number should be a small fraction of the first
+	STDMETHOD(GetWriteStats)(UINT64* pElementWrites, UINT64* pStreamWrites) PURE;
 	// TODO: chapters
 };
 
@@ -107,6 +117,23 @@ protected:
 
 	bool m_fNegative, m_fPositive;
 
+	std::atomic<UINT64> m_nElementWrites = 0;
+	std::atomic<UINT64> m_nStreamWrites  = 0;
+
+	// interleaver, the muxer thread takes the block with the lowest timecode from a
+	// heap of pins with queued blocks once no non-sparse track is waiting for data
+	std::mutex m_mutexQueue;
+	std::condition_variable m_condData;
+	std::vector<CMatroskaMuxerInputPin*> m_QueueHeap;
+	unsigned m_nBlockingPins = 0;
+	unsigned m_nRunningPins  = 0;
+	bool m_bAbort = false;
+
+	void UpdateQueueState(CMatroskaMuxerInputPin* pPin);
+	void RemoveFromQueueHeap(CMatroskaMuxerInputPin* pPin);
+
+	friend class CMatroskaMuxerInputPin;
+
 	enum { CMD_EXIT, CMD_RUN };
 	DWORD ThreadProc();
 
@@ -156,4 +183,5 @@ public:
 	// IMatroskaMuxer
 
 	STDMETHODIMP CorrectTimeOffset(bool fNegative, bool fPositive);
+	STDMETHODIMP GetWriteStats(UINT64* pElementWrites, UINT64* pStreamWrites);
 };
@@ -252,6 +252,9 @@ DWORD CBaseSplitterFilter::ThreadProc()
 	m_eEndFlush.Set();
 	m_fFlushing = false;
 
+	// embedded fonts must be available before the subtitles are delivered
+	m_fontinst.WaitFonts();
+
 	for (DWORD cmd = (DWORD)-1; ; cmd = GetRequest()) {
 		if (cmd == CMD_EXIT) {
 			m_hThread = nullptr;
@@ -26,6 +26,9 @@
 #include "BaseSplitterOutputPin.h"
 #include "BaseSplitter.h"
 
+// the zeroed padding after the packet data that lets FFmpeg based decoders read the sample without a copy (AV_INPUT_BUFFER_PADDING_SIZE)
+#define PACKET_PADDING_SIZE 64
+
 //
 // CBaseSplitterOutputPin
 //
@@ -423,7 +426,7 @@ HRESULT CBaseSplitterOutputPin::DeliverPacket(std::unique_ptr<CPacket> p)
 			if (S_OK != (hr = m_pAllocator->GetProperties(&props))) {
 				break;
 			}
-			props.cbBuffer = nBytes*3/2;
+			props.cbBuffer = (nBytes + PACKET_PADDING_SIZE)*3/2;
 
 			if (props.cBuffers > 1) {
 				if (S_OK != (hr = __super::DeliverBeginFlush())) {
@@ -473,6 +476,9 @@ HRESULT CBaseSplitterOutputPin::DeliverPacket(std::unique_ptr<CPacket> p)
 			break;
 		}
 		memcpy(pData, p->data(), nBytes);
+		if (nBytes + PACKET_PADDING_SIZE <= pSample->GetSize()) {
+			memset(pData + nBytes, 0, PACKET_PADDING_SIZE);
+		}
 		if (S_OK != (hr = pSample->SetActualDataLength(nBytes))) {
 			break;
 		}
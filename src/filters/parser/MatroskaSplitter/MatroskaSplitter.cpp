@@ -1801,6 +1801,10 @@ void CMatroskaSplitterFilter::SetupChapters(LPCSTR lng, ChapterAtom* parent, int
 
 void CMatroskaSplitterFilter::InstallFonts()
 {
+	// The attachments are read here, the fonts are installed in the background
+	// and the streaming thread waits for them before delivering the first packets.
+	std::vector<std::vector<BYTE>> fonts;
+
 	for (const auto& pA : m_pFile->m_segment.Attachments) {
 		for (const auto& pF : pA->AttachedFiles) {
 			if (pF->FileMimeType == "application/x-truetype-font" ||
@@ -1814,18 +1818,24 @@ void CMatroskaSplitterFilter::InstallFonts()
 					pF->FileMimeType == "font/otf") {
 				// assume this is a font resource
 
-				if (BYTE* pData = new(std::nothrow) BYTE[pF->FileDataLen]) {
-					m_pFile->Seek(pF->FileDataPos);
-
-					if (SUCCEEDED(m_pFile->ByteRead(pData, pF->FileDataLen))) {
-						m_fontinst.InstallFontMemory(pData, (UINT)pF->FileDataLen);
-					}
+				std::vector<BYTE> data;
+				try {
+					data.resize((size_t)pF->FileDataLen);
+				} catch (...) {
+					continue;
+				}
 
-					delete [] pData;
+				m_pFile->Seek(pF->FileDataPos);
+				if (FAILED(m_pFile->ByteRead(data.data(), pF->FileDataLen))) {
+					continue;
 				}
+
+				fonts.emplace_back(std::move(data));
 			}
 		}
 	}
+
+	m_fontinst.InstallFontsMemoryAsync(std::move(fonts));
 }
 
 void CMatroskaSplitterFilter::SendVorbisHeaderSample()
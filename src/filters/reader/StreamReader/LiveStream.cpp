@@ -76,19 +76,28 @@ void CLiveStream::Clear()
 
 	EmptyBuffer();
 
-	m_pos = m_len = 0;
+	m_pos = m_len = m_start = 0;
 	m_SizeComplete = 0;
 }
 
 void CLiveStream::Append(const BYTE* buff, UINT len)
 {
-	CAutoLock cPacketLock(&m_csPacketsLock);
+	std::unique_lock<std::mutex> lock(m_mutexBuffer);
+
+	const ULONGLONG end = m_len + len;
+	if (end - m_start > m_ringSize) {
+		// only discard what CheckBuffer() would discard, the rest is kept for seeking back
+		CheckBuffer();
+		if (end - m_start > m_ringSize) {
+			ResizeBuffer(end - m_start);
+		}
+	}
 
-	m_packets.emplace_back(buff, m_len, len);
-	m_len += len;
+	CopyToBuffer(m_len, buff, len);
+	m_len = end;
 
 	if (m_SizeComplete && m_len >= m_SizeComplete) {
-		m_EventComplete.Set();
+		m_condDataReady.notify_all();
 	}
 }
 
@@ -708,11 +717,12 @@ HRESULT CLiveStream::SetPointer(LONGLONG llPos)
 		return E_FAIL;
 	}
 
+	std::unique_lock<std::mutex> lock(m_mutexBuffer);
+
 	m_pos = llPos;
 
-	const __int64 start = m_packets.empty() ? 0 : m_packets.front().m_start;
-	if (llPos < start) {
-		DLog(L"CLiveStream::SetPointer() warning! %lld misses in [%llu - %llu]", llPos, start, m_packets.back().m_end);
+	if (m_pos < m_start) {
+		DLog(L"CLiveStream::SetPointer() warning! %lld misses in [%llu - %llu]", llPos, m_start, m_len);
 		return S_FALSE;
 	}
 
@@ -721,61 +731,56 @@ HRESULT CLiveStream::SetPointer(LONGLONG llPos)
 
 HRESULT CLiveStream::Read(PBYTE pbBuffer, DWORD dwBytesToRead, BOOL bAlign, LPDWORD pdwBytesRead)
 {
-	DWORD len = dwBytesToRead;
-	BYTE* ptr = pbBuffer;
+	{
+		std::unique_lock<std::mutex> lock(m_mutexBuffer);
 
-	if (!m_packets.empty()
-			&& m_pos + len > m_packets.back().m_end) {
-		m_SizeComplete = m_pos + len;
+		if (m_len > m_start
+				&& m_pos + dwBytesToRead > m_len) {
+			m_SizeComplete = m_pos + dwBytesToRead;
 
 #if DEBUG
-		DLog(L"CLiveStream::Read() : wait %llu bytes, %llu -> %llu", m_SizeComplete - m_packets.back().m_end, m_packets.back().m_end, m_SizeComplete);
-		const ULONGLONG start = GetPerfCounter();
+			DLog(L"CLiveStream::Read() : wait %llu bytes, %llu -> %llu", m_SizeComplete - m_len, m_len, m_SizeComplete);
+			const ULONGLONG start = GetPerfCounter();
 #endif
 
-		while (!m_bEndOfStream && !m_EventComplete.Wait(1));
-		m_SizeComplete = 0;
+			m_condDataReady.wait(lock, [&] { return m_bEndOfStream || m_len >= m_SizeComplete; });
+			m_SizeComplete = 0;
 
 #if DEBUG
-		const ULONGLONG end = GetPerfCounter();
-		DLog(L"    => do wait %0.3f ms", (end - start) / 10000.0);
+			const ULONGLONG end = GetPerfCounter();
+			DLog(L"    => do wait %0.3f ms", (end - start) / 10000.0);
 #endif
 
-		if (m_bEndOfStream) {
-			if (pdwBytesRead) {
-				*pdwBytesRead = 0;
-			}
+			if (m_bEndOfStream) {
+				if (pdwBytesRead) {
+					*pdwBytesRead = 0;
+				}
 
-			return E_FAIL;
+				return E_FAIL;
+			}
 		}
 	}
 
 	CAutoLock cAutoLock(&m_csLock);
-	CAutoLock cPacketLock(&m_csPacketsLock);
+	std::unique_lock<std::mutex> lock(m_mutexBuffer);
 
-	auto it = m_packets.cbegin();
-	while (it != m_packets.cend() && len > 0) {
-		const auto& p = *it++;
+	DWORD size = 0;
 
-		DLogIf(m_pos < p.m_start, L"CLiveStream::Read(): requested data is no longer available, %llu - %llu", m_pos, p.m_start);
-		if (p.m_start <= m_pos && m_pos < p.m_end) {
-			const DWORD size = std::min<DWORD>((ULONGLONG)len, p.m_end - m_pos);
-			memcpy(ptr, &p.m_buff.get()[m_pos - p.m_start], size);
+	DLogIf(m_pos < m_start, L"CLiveStream::Read(): requested data is no longer available, %llu - %llu", m_pos, m_start);
+	if (m_start <= m_pos && m_pos < m_len) {
+		size = (DWORD)std::min<ULONGLONG>(dwBytesToRead, m_len - m_pos);
+		CopyFromBuffer(m_pos, pbBuffer, size);
 
-			m_pos += size;
-
-			ptr += size;
-			len -= size;
-		}
+		m_pos += size;
 	}
 
 	if (pdwBytesRead) {
-		*pdwBytesRead = ptr - pbBuffer;
+		*pdwBytesRead = size;
 	}
 
 	CheckBuffer();
 
-	return len == dwBytesToRead ? E_FAIL : (len > 0 ? S_FALSE : S_OK);
+	return size == 0 ? E_FAIL : (size < dwBytesToRead ? S_FALSE : S_OK);
 }
 
 LONGLONG CLiveStream::Size(LONGLONG* pSizeAvailable)
@@ -804,32 +809,100 @@ void CLiveStream::Unlock()
 	m_csLock.Unlock();
 }
 
-inline const ULONGLONG CLiveStream::GetPacketsSize()
+void CLiveStream::CopyToBuffer(ULONGLONG pos, const BYTE* buff, size_t size)
+{
+	if (!size) {
+		return;
+	}
+
+	ASSERT(size <= m_ringSize);
+
+	const size_t offset = pos & (m_ringSize - 1);
+	const size_t first = std::min(size, m_ringSize - offset);
+
+	memcpy(&m_ring[offset], buff, first);
+	memcpy(&m_ring[0], buff + first, size - first);
+}
+
+void CLiveStream::CopyFromBuffer(ULONGLONG pos, BYTE* buff, size_t size) const
+{
+	if (!size) {
+		return;
+	}
+
+	ASSERT(size <= m_ringSize);
+
+	const size_t offset = pos & (m_ringSize - 1);
+	const size_t first = std::min(size, m_ringSize - offset);
+
+	memcpy(buff, &m_ring[offset], first);
+	memcpy(buff + first, &m_ring[0], size - first);
+}
+
+// the smallest ring of at least MAXSTORESIZE * 2 that holds size bytes, it can grow or shrink
+void CLiveStream::ResizeBuffer(size_t size)
 {
-	CAutoLock cPacketLock(&m_csPacketsLock);
+	size_t ringSize = MAXSTORESIZE * 2;
+	while (ringSize < size) {
+		ringSize <<= 1;
+	}
+
+	if (ringSize == m_ringSize) {
+		return;
+	}
+
+	auto ring = std::make_unique<BYTE[]>(ringSize);
+
+	const size_t dataSize = m_len - m_start;
+	if (dataSize) {
+		auto data = std::make_unique<BYTE[]>(dataSize);
+		CopyFromBuffer(m_start, data.get(), dataSize);
+
+		m_ring = std::move(ring);
+		m_ringSize = ringSize;
+		CopyToBuffer(m_start, data.get(), dataSize);
+	} else {
+		m_ring = std::move(ring);
+		m_ringSize = ringSize;
+	}
+}
+
+const ULONGLONG CLiveStream::GetBufferSize()
+{
+	std::unique_lock<std::mutex> lock(m_mutexBuffer);
 
-	return m_packets.empty() ? 0 : m_packets.back().m_end - m_packets.front().m_start;
+	return m_len - m_start;
 }
 
+// must be called with m_mutexBuffer locked
 void CLiveStream::CheckBuffer()
 {
 	if (m_RequestCmd == CMD::CMD_RUN) {
-		CAutoLock cPacketLock(&m_csPacketsLock);
-
 		if (m_pos > 256 * KILOBYTE) {
-			while (!m_packets.empty() && m_packets.front().m_start < m_pos - 256 * KILOBYTE) {
-				m_packets.pop_front();
-			}
+			m_start = std::clamp<ULONGLONG>(m_pos - 256 * KILOBYTE, m_start, m_len);
+		}
+
+		// give the memory of a burst back once the stored data fits in a quarter of the ring
+		const size_t dataSize = m_len - m_start;
+		if (m_ringSize > MAXSTORESIZE * 2 && dataSize < m_ringSize / 4) {
+			ResizeBuffer(dataSize * 2);
 		}
 	}
 }
 
 void CLiveStream::EmptyBuffer()
 {
-	CAutoLock cPacketLock(&m_csPacketsLock);
+	std::unique_lock<std::mutex> lock(m_mutexBuffer);
 
-	m_packets.clear();
-	m_len = m_pos;
+	m_start = m_len = m_pos;
+}
+
+void CLiveStream::SetEndOfStream()
+{
+	std::unique_lock<std::mutex> lock(m_mutexBuffer);
+
+	m_bEndOfStream = TRUE;
+	m_condDataReady.notify_all();
 }
 
 #define ENABLE_DUMP 0
@@ -861,7 +934,7 @@ DWORD CLiveStream::ThreadProc()
 					fclose(dump);
 				}
 #endif
-				m_bEndOfStream = TRUE;
+				SetEndOfStream();
 				EmptyBuffer();
 				return 0;
 			case CMD::CMD_STOP:
@@ -892,7 +965,7 @@ DWORD CLiveStream::ThreadProc()
 							(m_hlsData.bEndList
 							 || !ParseM3U8(m_hlsData.PlaylistUrl, m_hlsData.PlaylistUrl)
 							 || !OpenHLSSegment())) {
-							m_bEndOfStream = true;
+							SetEndOfStream();
 							break;
 						}
 					}
@@ -901,7 +974,7 @@ DWORD CLiveStream::ThreadProc()
 				while (!CheckRequest(nullptr)
 						&& attempts < 200 && !bEndOfStream) {
 
-					if (!m_SizeComplete && GetPacketsSize() > MAXSTORESIZE) {
+					if (!m_SizeComplete && GetBufferSize() > MAXSTORESIZE) {
 						Sleep(50);
 						continue;
 					}
@@ -1020,7 +1093,7 @@ DWORD CLiveStream::ThreadProc()
 				}
 
 				if (attempts >= 200 || bEndOfStream) {
-					m_bEndOfStream = TRUE;
+					SetEndOfStream();
 				}
 
 				break;
@@ -1030,12 +1103,3 @@ DWORD CLiveStream::ThreadProc()
 	ASSERT(0);
 	return DWORD_MAX;
 }
-
-CLiveStream::CPacket::CPacket(const BYTE* p, ULONGLONG start, UINT size)
-	: m_start(start)
-	, m_end(start + size)
-{
-	ASSERT(size > 0);
-	m_buff = std::make_unique<BYTE[]>(size);
-	memcpy(m_buff.get(), p, size);
-}
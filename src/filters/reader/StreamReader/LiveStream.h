@@ -21,6 +21,8 @@
 #pragma once
 
 #include <deque>
+#include <mutex>
+#include <condition_variable>
 #include <ExtLib/AsyncReader/asyncio.h>
 #include "DSUtil/HTTPAsync.h"
 #include "AESDecryptor.h"
@@ -41,17 +43,7 @@ public:
 	};
 
 private:
-	class CPacket
-	{
-	public:
-		std::unique_ptr<BYTE[]> m_buff;
-		ULONGLONG m_start, m_end;
-
-		CPacket(const BYTE* p, ULONGLONG start, UINT size);
-	};
-
 	CCritSec           m_csLock;
-	CCritSec           m_csPacketsLock;
 
 	CString            m_url_str;
 	protocol           m_protocol   = protocol::PR_NONE;
@@ -68,9 +60,13 @@ private:
 	ULONGLONG          m_len = 0;
 	DWORD              m_nBytesRead = 0;
 
-	std::deque<CPacket> m_packets;
+	// received data is stored in a ring buffer, [m_start, m_len) is the stored range of the stream
+	std::unique_ptr<BYTE[]> m_ring;
+	size_t             m_ringSize = 0; // always a power of two
+	ULONGLONG          m_start = 0;
 
-	CAMEvent           m_EventComplete;
+	std::mutex         m_mutexBuffer; // to protect m_ring, m_start, m_len, m_pos
+	std::condition_variable m_condDataReady;
 
 	volatile ULONGLONG m_SizeComplete = 0;
 	volatile BOOL      m_bEndOfStream = FALSE;
@@ -108,9 +104,14 @@ private:
 	void Append(const BYTE* buff, UINT len);
 	HRESULT HTTPRead(PBYTE pBuffer, DWORD dwSizeToRead, LPDWORD dwSizeRead, DWORD dwTimeOut = INFINITE);
 
-	inline const ULONGLONG GetPacketsSize();
+	void CopyToBuffer(ULONGLONG pos, const BYTE* buff, size_t size);
+	void CopyFromBuffer(ULONGLONG pos, BYTE* buff, size_t size) const;
+	void ResizeBuffer(size_t size);
+
+	const ULONGLONG GetBufferSize();
 	void CheckBuffer();
 	void EmptyBuffer();
+	void SetEndOfStream();
 
 	DWORD ThreadProc();
 
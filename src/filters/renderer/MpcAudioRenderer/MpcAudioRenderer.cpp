@@ -49,6 +49,9 @@
 // set to 1(or more) to enable more detail debug log
 #define DBGLOG_LEVEL 1
 
+#define GAIN_RAMP_TIME  20 // ms
+#define GAIN_RAMP_BLOCK 32 // frames with the same gain during the ramp
+
 #ifdef REGISTER_FILTER
 
 const AMOVIESETUP_MEDIATYPE sudPinTypesIn[] = {
@@ -2881,8 +2884,11 @@ HRESULT CMpcAudioRenderer::RenderWasapiBuffer()
 
 		if (m_lVolume <= DSBVOLUME_MIN) {
 			dwFlags = AUDCLNT_BUFFERFLAGS_SILENT;
+			// unmute starts with a ramp from silence
+			memset(m_dChannelGains, 0, sizeof(m_dChannelGains));
+			m_nGainRampBlocks = 0;
 		}
-		else if (!m_bIsBitstream && (m_lVolume < DSBVOLUME_MAX || m_lBalance != DSBPAN_CENTER)) {
+		else if (!m_bIsBitstream) {
 			ApplyVolumeBalance(pData, nAvailableBytes);
 		}
 	}
@@ -3084,92 +3090,111 @@ void CMpcAudioRenderer::ReleaseDevice()
 
 void CMpcAudioRenderer::ApplyVolumeBalance(BYTE* pData, UINT32 size)
 {
-	const SampleFormat sf   = m_output_params.sf;
-	const size_t channels   = m_output_params.channels;
-	const size_t allsamples = size / (m_pWaveFormatExOutput->wBitsPerSample / 8);
-	const size_t samples    = allsamples / channels;
+	const SampleFormat sf    = m_output_params.sf;
+	const unsigned channels  = m_output_params.channels;
+	const size_t framesize   = channels * (m_pWaveFormatExOutput->wBitsPerSample / 8);
+	if (!framesize) {
+		return;
+	}
+	const size_t samples     = size / framesize;
 
-	if (m_lBalance == DSBPAN_CENTER) {
+	if (channels > 32) {
+		// the balance mask and the per-channel gains cover 32 channels, apply only the volume
+		if (m_dVolumeFactor != 1.0) {
+			const size_t allsamples = samples * channels;
+			switch (sf) {
+			case SAMPLE_FMT_U8:
+				gain_uint8(m_dVolumeFactor, allsamples, (uint8_t*)pData);
+				break;
+			case SAMPLE_FMT_S16:
+				gain_int16(m_dVolumeFactor, allsamples, (int16_t*)pData);
+				break;
+			case SAMPLE_FMT_S24:
+				gain_int24(m_dVolumeFactor, allsamples, pData);
+				break;
+			case SAMPLE_FMT_S32:
+				gain_int32(m_dVolumeFactor, allsamples, (int32_t*)pData);
+				break;
+			case SAMPLE_FMT_FLT:
+				gain_float(m_dVolumeFactor, allsamples, (float*)pData);
+				break;
+			case SAMPLE_FMT_DBL:
+				gain_double(m_dVolumeFactor, allsamples, (double*)pData);
+				break;
+			}
+		}
+		m_nGainChannels = 0;
+		return;
+	}
+
+	// target gain of each channel
+	// do not use limiter, because m_dBalanceFactor and m_dVolumeFactor are always less than or equal to 1.0
+	double gains[32];
+	for (unsigned ch = 0; ch < channels; ch++) {
+		gains[ch] = (m_dwBalanceMask & (1u << ch)) ? m_dBalanceFactor : m_dVolumeFactor;
+	}
+
+	const size_t gains_size = channels * sizeof(double);
+	if (channels != m_nGainChannels) {
+		m_nGainChannels = channels;
+		memcpy(m_dChannelGains, gains, gains_size);
+		memcpy(m_dChannelGainsTarget, gains, gains_size);
+		m_nGainRampBlocks = 0;
+	}
+	else if (memcmp(gains, m_dChannelGainsTarget, gains_size) || !m_nGainRampBlocks && memcmp(gains, m_dChannelGains, gains_size)) {
+		// new target, ramp to it to avoid zipper noise
+		memcpy(m_dChannelGainsTarget, gains, gains_size);
+		m_nGainRampBlocks = std::max(1u, (unsigned)m_output_params.samplerate * GAIN_RAMP_TIME / 1000 / GAIN_RAMP_BLOCK);
+		for (unsigned ch = 0; ch < channels; ch++) {
+			m_dChannelGainSteps[ch] = (gains[ch] - m_dChannelGains[ch]) / m_nGainRampBlocks;
+		}
+	}
+
+	auto ApplyGains = [&](BYTE* p, const size_t allsamples) {
 		switch (sf) {
 		case SAMPLE_FMT_U8:
-			gain_uint8(m_dVolumeFactor, allsamples, (uint8_t*)pData);
+			gain_uint8_ch(m_dChannelGains, channels, allsamples, (uint8_t*)p);
 			break;
 		case SAMPLE_FMT_S16:
-			gain_int16(m_dVolumeFactor, allsamples, (int16_t*)pData);
+			gain_int16_ch(m_dChannelGains, channels, allsamples, (int16_t*)p);
 			break;
 		case SAMPLE_FMT_S24:
-			gain_int24(m_dVolumeFactor, allsamples, pData);
+			gain_int24_ch(m_dChannelGains, channels, allsamples, p);
 			break;
 		case SAMPLE_FMT_S32:
-			gain_int32(m_dVolumeFactor, allsamples, (int32_t*)pData);
+			gain_int32_ch(m_dChannelGains, channels, allsamples, (int32_t*)p);
 			break;
 		case SAMPLE_FMT_FLT:
-			gain_float(m_dVolumeFactor, allsamples, (float*)pData);
+			gain_float_ch(m_dChannelGains, channels, allsamples, (float*)p);
 			break;
 		case SAMPLE_FMT_DBL:
-			gain_double(m_dVolumeFactor, allsamples, (double*)pData);
+			gain_double_ch(m_dChannelGains, channels, allsamples, (double*)p);
 			break;
 		}
-	} else {
-		// volume and balance
-		// do not use limiter, because  m_dBalanceFactor and m_dVolumeFactor are always less than or equal to 1.0
-		switch (sf) {
-		case SAMPLE_FMT_U8: {
-			uint8_t* p = (uint8_t*)pData;
-			for (size_t i = 0; i < samples; i++) {
-				for (size_t ch = 0; ch < channels; ch++) {
-					int8_t sample = (int8_t)(*p ^ 0x80);
-					sample = (int8_t)((m_dwBalanceMask & (1 << ch) ? m_dBalanceFactor : m_dVolumeFactor) * sample);
-					*p++ = (uint8_t)sample ^ 0x80;
-				}
-			}
-			break; }
-		case SAMPLE_FMT_S16: {
-			int16_t* p = (int16_t*)pData;
-			for (size_t i = 0; i < samples; i++) {
-				for (size_t ch = 0; ch < channels; ch++) {
-					*p++ = (int16_t)((m_dwBalanceMask & (1 << ch) ? m_dBalanceFactor : m_dVolumeFactor) * *p);
-				}
-			}
-			break; }
-		case SAMPLE_FMT_S24: {
-			for (size_t i = 0; i < samples; i++) {
-				for (size_t ch = 0; ch < channels; ch++) {
-					int32_t sample = 0;
-					((BYTE*)(&sample))[1] = *(pData);
-					((BYTE*)(&sample))[2] = *(pData + 1);
-					((BYTE*)(&sample))[3] = *(pData + 2);
-					sample = (int32_t)((m_dwBalanceMask & (1 << ch) ? m_dBalanceFactor : m_dVolumeFactor) * sample);
-					*pData++ = ((BYTE*)(&sample))[1];
-					*pData++ = ((BYTE*)(&sample))[2];
-					*pData++ = ((BYTE*)(&sample))[3];
-				}
-			}
-			break; }
-		case SAMPLE_FMT_S32: {
-			int32_t* p = (int32_t*)pData;
-			for (size_t i = 0; i < samples; i++) {
-				for (size_t ch = 0; ch < channels; ch++) {
-					*p++ = (int32_t)((m_dwBalanceMask & (1 << ch) ? m_dBalanceFactor : m_dVolumeFactor) * *p);
-				}
-			}
-			break; }
-		case SAMPLE_FMT_FLT: {
-			float* p = (float*)pData;
-			for (size_t i = 0; i < samples; i++) {
-				for (size_t ch = 0; ch < channels; ch++) {
-					*p++ = (float)((m_dwBalanceMask & (1 << ch) ? m_dBalanceFactor : m_dVolumeFactor) * *p);
-				}
-			}
-			break; }
-		case SAMPLE_FMT_DBL: {
-			double* p = (double*)pData;
-			for (size_t i = 0; i < samples; i++) {
-				for (size_t ch = 0; ch < channels; ch++) {
-					*p++ = (m_dwBalanceMask & (1 << ch) ? m_dBalanceFactor : m_dVolumeFactor) * *p;
-				}
+	};
+
+	size_t pos = 0;
+	while (m_nGainRampBlocks && pos < samples) {
+		if (--m_nGainRampBlocks) {
+			for (unsigned ch = 0; ch < channels; ch++) {
+				m_dChannelGains[ch] += m_dChannelGainSteps[ch];
 			}
-			break; }
+		} else {
+			memcpy(m_dChannelGains, m_dChannelGainsTarget, gains_size);
+		}
+
+		const size_t count = std::min<size_t>(GAIN_RAMP_BLOCK, samples - pos);
+		ApplyGains(pData + pos * framesize, count * channels);
+		pos += count;
+	}
+
+	if (pos < samples) {
+		bool bUnity = true;
+		for (unsigned ch = 0; ch < channels; ch++) {
+			bUnity &= (m_dChannelGains[ch] == 1.0);
+		}
+		if (!bUnity) {
+			ApplyGains(pData + pos * framesize, (samples - pos) * channels);
 		}
 	}
 }
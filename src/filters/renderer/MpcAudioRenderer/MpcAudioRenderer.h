@@ -202,6 +202,13 @@ private:
 	DWORD  m_dwBalanceMask;
 	bool   m_bUpdateBalanceMask; // TODO: remove it
 
+	// per-channel gains applied to the output, ramped on changes
+	double   m_dChannelGains[32]       = {};
+	double   m_dChannelGainsTarget[32] = {};
+	double   m_dChannelGainSteps[32]   = {};
+	unsigned m_nGainChannels           = 0;
+	unsigned m_nGainRampBlocks         = 0;
+
 	void SetBalanceMask(const DWORD output_layout);
 	void ApplyVolumeBalance(BYTE* pData, UINT32 size);
 
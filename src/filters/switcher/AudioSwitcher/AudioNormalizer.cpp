@@ -1,5 +1,5 @@
 /*
- * (C) 2014-2022 see Authors.txt
+ * (C) 2014-2026 see Authors.txt
  *
  * This file is part of MPC-BE.
  *
@@ -19,301 +19,340 @@
  */
 
 #include "stdafx.h"
+#include <MMReg.h>
+#include <emmintrin.h>
+#include "DSUtil/Utils.h"
 #include "AudioNormalizer.h"
 
+#define TP_LAG         6           // lag of the true-peak interpolator, input samples
+#define TP_CEILING_DB  -1.0        // dBTP, the highest ceiling
+#define PLR_DB         18.0        // typical peak to loudness ratio of music and films
+#define ABSOLUTE_GATE  -70.0       // LUFS
+#define GAIN_MIN_DB    -24.0
+#define GAIN_MAX_DB    18.0
+#define GAIN_ATTACK    1.0         // seconds
+
 //
 // CAudioNormalizer
 //
 
 CAudioNormalizer::CAudioNormalizer()
 {
-	memset(m_prediction, 7, sizeof(m_prediction));
-}
-
-CAudioNormalizer::~CAudioNormalizer()
-{
-}
-
-int CAudioNormalizer::ProcessInternal(float *samples, unsigned numsamples, unsigned nch)
-{
-	if (m_vol <= 0) {
-		m_vol = 1;
+	// 4x oversampling interpolator (windowed sinc), split into four phases
+	const int N = TP_TAPS * 4;
+	double h[N];
+	for (int n = 0; n < N; n++) {
+		const double t = M_PI * (n - (N - 1) / 2.0) / 4.0;
+		const double w = 0.5 - 0.5 * cos(2.0 * M_PI * (n + 0.5) / N);
+		h[n] = sin(t) / t * w;
 	}
 
-	const size_t allsamples = numsamples * nch;
-
-	float max_peak = 0.0f;
-	for (size_t k = 0; k < allsamples; k++) {
-		max_peak = std::max(max_peak , std::abs(samples[k]));
-	}
-
-	int tries = 0;
-
-redo:
-	const double factor = m_vol != m_stepping_vol ? (double)m_vol / (double)(m_stepping_vol) : 1.0;
-	const double highest = (double)max_peak * factor * 32768;
-
-	if (highest > 30000.0) {
-		if (m_vol > m_stepping) {
-			m_vol -= m_stepping;
-		} else {
-			m_vol = 1;
+	for (int phase = 0; phase < 4; phase++) {
+		double sum = 0.0;
+		for (int m = 0; m < TP_TAPS; m++) {
+			sum += h[phase + 4 * m];
 		}
-		tries++;
-		if (tries < 1024) {
-			goto redo;
-		} else {
-			return numsamples;
+		// coefficients are ordered from the oldest sample to the newest one
+		for (int m = 0; m < TP_TAPS; m++) {
+			m_tp_coefs[TP_TAPS - 1 - m][phase] = (float)(h[phase + 4 * m] / sum);
 		}
 	}
+}
 
-	if (highest > 10.0) {
-		const double t = (m_level << 15) / 100.0;
-		if (highest > t) {
-			if (m_prediction[m_predictor] > 0) {
-				m_prediction[m_predictor] = m_prediction[m_predictor] - 1;
-			} else {
-				m_prediction[m_predictor] = 0;
-			}
-			const int predict = m_prediction[m_predictor];
-			m_predictor >>= 1;
-			m_rising = 0;
-			if (predict <= 7 && m_vol > 1) {
-				m_vol--;
+void CAudioNormalizer::Init()
+{
+	m_nch = CountBits(m_layout);
+	m_channels.assign(m_nch, {});
+
+	// channel weights for the loudness, BS.1770
+	unsigned ch = 0;
+	for (uint32_t bit = 1; bit && ch < m_nch; bit <<= 1) {
+		if (m_layout & bit) {
+			if (bit == SPEAKER_LOW_FREQUENCY) {
+				m_channels[ch].weight = 0.0f;
 			}
-		} else { // highest <= t
-			if (m_prediction[m_predictor] < 15) {
-				m_prediction[m_predictor] = m_prediction[m_predictor] + 1;
-			} else {
-				m_prediction[m_predictor] = 15;
+			else if (bit & (SPEAKER_BACK_LEFT|SPEAKER_BACK_RIGHT|SPEAKER_SIDE_LEFT|SPEAKER_SIDE_RIGHT)) {
+				m_channels[ch].weight = 1.41f;
 			}
-			const int predict = m_prediction[m_predictor];
-			m_predictor = (m_predictor >> 1) | 0x800;
-			if (predict >= 8) {
-				m_vol += (++m_rising < 128) ? 1 : m_stepping;
+			else {
+				m_channels[ch].weight = 1.0f;
 			}
+			ch++;
 		}
 	}
 
-	for (size_t k = 0; k < allsamples; k++) {
-		samples[k] *= factor;
-	}
-
-	if (m_boost == false && m_vol > m_stepping_vol) {
-		m_vol = m_stepping_vol;
+	// K-weighting filters, recalculated for the sample rate
+	{
+		double f0 = 1681.974450955533;
+		double G  = 3.999843853973347;
+		double Q  = 0.7071752369554196;
+		double K  = tan(M_PI * f0 / m_samplerate);
+		const double Vh = pow(10.0, G / 20.0);
+		const double Vb = pow(Vh, 0.4996667741545416);
+		double a0 = 1.0 + K / Q + K * K;
+
+		m_prefilter.b0 = (Vh + Vb * K / Q + K * K) / a0;
+		m_prefilter.b1 = 2.0 * (K * K - Vh) / a0;
+		m_prefilter.b2 = (Vh - Vb * K / Q + K * K) / a0;
+		m_prefilter.a1 = 2.0 * (K * K - 1.0) / a0;
+		m_prefilter.a2 = (1.0 - K / Q + K * K) / a0;
+
+		f0 = 38.13547087602444;
+		Q  = 0.5003270373238773;
+		K  = tan(M_PI * f0 / m_samplerate);
+		a0 = 1.0 + K / Q + K * K;
+
+		m_rlbfilter.b0 = 1.0;
+		m_rlbfilter.b1 = -2.0;
+		m_rlbfilter.b2 = 1.0;
+		m_rlbfilter.a1 = 2.0 * (K * K - 1.0) / a0;
+		m_rlbfilter.a2 = (1.0 - K / Q + K * K) / a0;
 	}
 
-	return numsamples;
-}
+	m_block_size = std::max(1u, m_samplerate / 10);
+	m_attack     = std::max(1u, m_samplerate / 200);
+	m_window     = m_attack + TP_LAG;
 
-int CAudioNormalizer::Process(float *samples, unsigned numsamples, unsigned nch)
-{
-	int ret = 0;
+	m_delay.resize((m_window - 1) * m_nch);
+	m_minqueue.resize(m_window);
+	m_attack_buf.resize(m_attack);
+	m_lim_release = (float)(1.0 - exp(-1.0 / (0.05 * m_samplerate)));
 
-	while (numsamples > 0) {
-		const unsigned process = std::min(numsamples, 512u);
+	memset(m_energy, 0, sizeof(m_energy));
+	m_energy_pos   = 0;
+	m_energy_count = 0;
 
-		ret += ProcessInternal(samples, process, nch);
-		numsamples -= process;
-		samples += (process * nch);
-	}
+	m_gain_db     = 0.0;
+	m_gain        = 1.0f;
+	m_gain_target = 1.0f;
+	m_gain_step   = 0.0f;
 
-	return ret;
+	Flush();
 }
 
-void CAudioNormalizer::SetParam(int Level, bool Boost, int Steping)
+void CAudioNormalizer::Flush()
 {
-	m_level = Level;
-	m_boost = Boost;
-	if (m_stepping != Steping) {
-		m_vol = (m_vol << Steping) / (1 << m_stepping);
-
-		m_stepping = Steping;
-		m_stepping_vol = 1 << m_stepping;
+	for (auto& ch : m_channels) {
+		memset(ch.s, 0, sizeof(ch.s));
+		memset(ch.history, 0, sizeof(ch.history));
+		ch.history_pos = 0;
 	}
-}
 
-//
-// CAudioAutoVolume
-//
+	m_block_pos    = 0;
+	m_block_energy = 0.0;
 
-CAudioAutoVolume::CAudioAutoVolume()
-{
-	for (size_t i = 0; i < std::size(m_smooth); i++)
-	{
-		m_smooth[i] = SmoothNew(100);
-	}
-}
+	m_gain      = m_gain_target;
+	m_gain_step = 0.0f;
 
-CAudioAutoVolume::~CAudioAutoVolume()
-{
-	for (size_t i = 0; i < std::size(m_smooth); i++)
-	{
-		if (m_smooth[i]) SmoothDelete(m_smooth[i]);
-	}
+	std::fill(m_delay.begin(), m_delay.end(), 0.0f);
+	m_delay_pos = 0;
+
+	m_minqueue_head  = 0;
+	m_minqueue_count = 0;
+	std::fill(m_attack_buf.begin(), m_attack_buf.end(), 1.0f);
+	m_attack_pos = 0;
+	m_attack_sum = m_attack;
+	m_lim_gain   = 1.0f;
+	m_frame      = 0;
 }
 
-int CAudioAutoVolume::Process(float *samples, int numsamples, int nch)
+float CAudioNormalizer::TruePeak(channel_t& ch, const float x)
 {
-	const size_t allsamples = numsamples * nch;
-	for (size_t k = 0; k < allsamples; k++) {
-		samples[k] *= INT16_MAX;
+	ch.history[ch.history_pos] = x;
+	ch.history[ch.history_pos + TP_TAPS] = x;
+	if (++ch.history_pos == TP_TAPS) {
+		ch.history_pos = 0;
 	}
+	const float* h = &ch.history[ch.history_pos];
 
-	double level = -1.0;
+	// all four phases at once
+	__m128 acc = _mm_setzero_ps();
+	for (int k = 0; k < TP_TAPS; k++) {
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(m_tp_coefs[k]), _mm_set1_ps(h[k])));
+	}
+	acc = _mm_andnot_ps(_mm_set1_ps(-0.0f), acc);
+	acc = _mm_max_ps(acc, _mm_movehl_ps(acc, acc));
+	acc = _mm_max_ss(acc, _mm_shuffle_ps(acc, acc, 1));
 
-	calc_power_level(samples, numsamples, nch);
-	{
-		int channel = 0;
+	return std::max(std::abs(x), _mm_cvtss_f32(acc));
+}
 
-		level = -1.0;
-		for (channel = 0; channel < nch; ++channel)
-		{
-			double channel_level = SmoothGetMax(m_smooth[channel]);
+float CAudioNormalizer::LimiterGain(const float required)
+{
+	const unsigned frame = m_frame++;
 
-			if (channel_level > level) level = channel_level;
-		}
+	// sliding minimum of the required gain over m_window frames
+	if (m_minqueue_count && frame - m_minqueue[m_minqueue_head].second >= m_window) {
+		m_minqueue_head = (m_minqueue_head + 1) % m_window;
+		m_minqueue_count--;
 	}
+	while (m_minqueue_count && m_minqueue[(m_minqueue_head + m_minqueue_count - 1) % m_window].first >= required) {
+		m_minqueue_count--;
+	}
+	m_minqueue[(m_minqueue_head + m_minqueue_count) % m_window] = { required, frame };
+	m_minqueue_count++;
 
-	if (level > m_silence_level)
-	{
-		double gain = m_normalize_level / level;
-
-		if (gain > m_max_mult) gain = m_max_mult;
+	const float min_gain = m_minqueue[m_minqueue_head].first;
 
-		adjust_gain(samples, numsamples, nch, gain);
+	// moving average over the attack time, it reaches the minimum when the peak leaves the delay line
+	m_attack_sum += min_gain - m_attack_buf[m_attack_pos];
+	m_attack_buf[m_attack_pos] = min_gain;
+	if (++m_attack_pos == m_attack) {
+		m_attack_pos = 0;
 	}
+	const float gain = (float)(m_attack_sum / m_attack);
 
-	for (size_t k = 0; k < allsamples; k++) {
-		samples[k] /= INT16_MAX;
+	if (gain < m_lim_gain) {
+		m_lim_gain = gain;
+	} else {
+		m_lim_gain += (gain - m_lim_gain) * m_lim_release;
 	}
 
-	return numsamples;
+	return m_lim_gain;
 }
 
-void CAudioAutoVolume::calc_power_level(float *samples, int numsamples, int nch)
+void CAudioNormalizer::UpdateGain()
 {
-	int channel = 0;
-	int i = 0;
-	double sum[8];
-	float *data = samples;
-
-	for (channel = 0; channel < nch; ++channel)
-	{
-		sum[channel] = 0.0;
+	m_energy[m_energy_pos] = m_block_energy / m_block_size;
+	m_energy_pos = (m_energy_pos + 1) % std::size(m_energy);
+	if (m_energy_count < std::size(m_energy)) {
+		m_energy_count++;
 	}
+	m_block_pos    = 0;
+	m_block_energy = 0.0;
 
-	for (i = 0, channel = 0; i < numsamples * nch; ++i, ++data)
-	{
-		double sample = *data;
-		double temp = 0.0;
-
-		if (m_do_compress)
-		{
-			if (sample > m_cutoff) sample = m_cutoff + (sample - m_cutoff) / m_degree;
+	// short-term loudness
+	double energy = 0.0;
+	for (unsigned i = 0; i < m_energy_count; i++) {
+		energy += m_energy[i];
+	}
+	energy /= m_energy_count;
+
+	if (energy > 0.0) {
+		const double loudness = -0.691 + 10.0 * log10(energy);
+		if (loudness > ABSOLUTE_GATE) {
+			const double target = std::clamp(m_target - loudness, GAIN_MIN_DB, m_boost ? GAIN_MAX_DB : 0.0);
+			const double time = (target < m_gain_db) ? GAIN_ATTACK : m_release;
+			m_gain_db += (target - m_gain_db) * (1.0 - exp(-0.1 / time));
 		}
-
-		temp = sample*sample;
-
-		sum[channel] += temp;
-
-		++channel;
-		channel = channel % nch;
+	}
+	if (!m_boost && m_gain_db > 0.0) {
+		m_gain_db = 0.0;
 	}
 
-	{
-		static const double NORMAL = 1.0 / (double)INT16_MAX;
-		static const double NORMAL_SQUARED = NORMAL * NORMAL;
-		double channel_length = 2.0 / (numsamples * nch);
-
-		for (channel = 0; channel < nch; ++channel)
-		{
-			double level = sum[channel] * channel_length * NORMAL_SQUARED;
+	m_gain        = m_gain_target;
+	m_gain_target = (float)pow(10.0, m_gain_db / 20.0);
+	m_gain_step   = (m_gain_target - m_gain) / m_block_size;
 
-			SmoothAddSample(m_smooth[channel], sqrt(level));
+	// avoid denormals in the filters on silence
+	for (auto& ch : m_channels) {
+		for (auto& s : ch.s) {
+			if (std::abs(s[0]) < 1e-30) s[0] = 0.0;
+			if (std::abs(s[1]) < 1e-30) s[1] = 0.0;
 		}
 	}
 }
 
-void CAudioAutoVolume::adjust_gain(float *samples, int numsamples, int nch, double gain)
+void CAudioNormalizer::SetParam(int Level, bool Boost, int RealeaseTime)
 {
-	float *data = samples;
-	int i = 0;
-#define NO_GAIN 0.01
-
-	if (gain >= 1.0 - NO_GAIN && gain <= 1.0 + NO_GAIN) return;
+	// Level keeps its meaning from the peak normalizer this class replaces: the highest peak in percent
+	// of full scale. It is the limiter ceiling (at most -1 dBTP), the loudness target is PLR_DB below it.
+	// The default level 75 gives a -2.5 dBTP ceiling and a -20.5 LUFS target.
+	const double peak_db = 20.0 * log10(std::clamp(Level, 1, 100) / 100.0);
+	m_ceiling = (float)pow(10.0, std::min(peak_db, TP_CEILING_DB) / 20.0);
+	m_target  = peak_db - PLR_DB;
+	m_boost   = Boost;
+	m_release = std::max(1, RealeaseTime);
+}
 
-	for (i = 0; i < numsamples * nch; ++i, ++data)
-	{
-		double samp = (double)*data;
+void CAudioNormalizer::UpdateInput(uint32_t layout, unsigned samplerate)
+{
+	if (layout != m_layout || samplerate != m_samplerate) {
+		m_layout     = layout;
+		m_samplerate = samplerate;
 
-		if (m_do_compress)
-		{
-			if (samp > m_cutoff) samp = m_cutoff + (samp - m_cutoff) / m_degree;
-		}
-		samp *= gain;
-		*data = (float)std::clamp(samp, (double)INT16_MIN, (double)INT16_MAX);
+		Init();
 	}
 }
 
-CAudioAutoVolume::smooth_t *CAudioAutoVolume::SmoothNew(int size)
+int CAudioNormalizer::Process(float *samples, unsigned numsamples, unsigned nch)
 {
-	smooth_t * sm = (smooth_t *)malloc(sizeof(smooth_t));
-	if (sm == nullptr) return nullptr;
+	if (nch != m_nch || !m_samplerate) {
+		ASSERT(0);
+		return numsamples;
+	}
 
-	ZeroMemory(sm, sizeof(smooth_t));
+	const auto& pre = m_prefilter;
+	const auto& rlb = m_rlbfilter;
+	const unsigned delay = m_window - 1;
 
-	sm->data = (double *)malloc(size * sizeof(double));
-	if (sm->data == nullptr)
-	{
-		free(sm);
-		return nullptr;
-	}
-	ZeroMemory(sm->data, size * sizeof(double));
+	for (unsigned i = 0; i < numsamples; i++) {
+		float* frame   = samples + i * nch;
+		float* delayed = &m_delay[m_delay_pos * nch];
 
-	sm->size = size;
-	sm->current = sm->used = 0;
-	sm->max = 0.0;
-	return sm;
-}
+		double energy = 0.0;
+		float peak = 0.0f;
 
-void CAudioAutoVolume::SmoothDelete(smooth_t *del)
-{
-	if (del == nullptr)
-		return;
+		for (unsigned c = 0; c < nch; c++) {
+			channel_t& ch = m_channels[c];
+			const float x = frame[c];
 
-	if (del->data != nullptr) free(del->data);
+			// K-weighting
+			const double y1 = pre.b0 * x + ch.s[0][0];
+			ch.s[0][0] = pre.b1 * x - pre.a1 * y1 + ch.s[0][1];
+			ch.s[0][1] = pre.b2 * x - pre.a2 * y1;
+			const double y2 = rlb.b0 * y1 + ch.s[1][0];
+			ch.s[1][0] = rlb.b1 * y1 - rlb.a1 * y2 + ch.s[1][1];
+			ch.s[1][1] = rlb.b2 * y1 - rlb.a2 * y2;
+			energy += ch.weight * y2 * y2;
 
-	free(del);
-}
+			peak = std::max(peak, TruePeak(ch, x));
 
-void CAudioAutoVolume::SmoothAddSample(smooth_t *sm, double sample)
-{
-	if (sm == nullptr)	return;
+			frame[c]   = delayed[c];
+			delayed[c] = x * m_gain;
+		}
+		if (++m_delay_pos == delay) {
+			m_delay_pos = 0;
+		}
 
-	sm->data[sm->current] = sample;
+		// gain required to keep the true peak under the ceiling, applied ahead of the peak
+		const float level = peak * m_gain;
+		const float gain = LimiterGain(level > m_ceiling ? m_ceiling / level : 1.0f);
+		for (unsigned c = 0; c < nch; c++) {
+			frame[c] *= gain;
+		}
 
-	++sm->current;
+		m_gain += m_gain_step;
+		m_block_energy += energy;
+		if (++m_block_pos == m_block_size) {
+			UpdateGain();
+		}
+	}
 
-	if (sm->current > sm->used) ++sm->used;
-	if (sm->current >= sm->size) sm->current %= sm->size;
+	return numsamples;
 }
 
-double CAudioAutoVolume::SmoothGetMax(smooth_t *sm)
+unsigned CAudioNormalizer::GetTailSize() const
 {
-	if (sm == nullptr) return -1.0;
-
-	{
-		int i = 0;
-		double smoothed = 0.0;
-
-		for (i = 0; i < sm->used; ++i) smoothed += sm->data[i];
-		smoothed = smoothed / sm->used;
-
-		if (sm->used < sm->size) return (smoothed * sm->used + m_normalize_level * (sm->size - sm->used)) / sm->size;
+	// input frames still held in the delay line
+	return m_samplerate ? std::min(m_frame, m_window - 1) : 0;
+}
 
-		if (sm->max < smoothed) sm->max = smoothed;
+int CAudioNormalizer::Drain(float *samples, unsigned nch)
+{
+	// push silence through the delay line, samples must have room for GetTailSize() frames
+	int numsamples = 0;
+	if (nch == m_nch) {
+		numsamples = GetTailSize();
+		memset(samples, 0, numsamples * nch * sizeof(float));
+		numsamples = Process(samples, numsamples, nch);
 	}
+	Flush();
 
-	return sm->max;
+	return numsamples;
+}
+
+REFERENCE_TIME CAudioNormalizer::GetDelay() const
+{
+	return m_samplerate ? 10000000LL * (m_window - 1) / m_samplerate : 0;
 }
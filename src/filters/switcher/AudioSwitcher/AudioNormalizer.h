@@ -1,5 +1,5 @@
 /*
- * (C) 2014-2021 see Authors.txt
+ * (C) 2014-2026 see Authors.txt
  *
  * This file is part of MPC-BE.
  *
@@ -23,65 +23,89 @@
 //
 // CAudioNormalizer
 //
+// Loudness normalizer with a lookahead true-peak limiter.
+// Loudness is measured as in EBU R128 / ITU-R BS.1770 (K-weighting, short-term 3 s window)
+// and the gain is smoothly moved to the target. The limiter computes the gain required for
+// each frame directly from the true peak (4x oversampled) and applies it ahead of the peak.
+//
+
+#define TP_TAPS 12 // taps per phase of the true-peak interpolator
 
 class CAudioNormalizer
 {
-protected:
-	int  m_level = 75;
-	bool m_boost =true;
-	int  m_stepping = 8;
-	int  m_stepping_vol = 1 << m_stepping;
-	int  m_rising = 0;
+	struct biquad_t {
+		double b0, b1, b2, a1, a2;
+	};
 
-	int m_vol = m_stepping_vol;
+	struct channel_t {
+		float    weight;
+		double   s[2][2];                // K-weighting filter states
+		float    history[TP_TAPS * 2];   // input history for the true-peak interpolator (mirrored)
+		unsigned history_pos;
+	};
 
-	unsigned m_predictor = 0;
-	BYTE m_prediction[4096];
+	// parameters
+	double   m_target  = -20.5;     // LUFS
+	float    m_ceiling = 0.749894f; // linear, -2.5 dBTP
+	bool     m_boost   = true;
+	int      m_release = 8;         // seconds
 
-	int ProcessInternal(float *samples, unsigned numsamples, unsigned nch);
+	// input
+	uint32_t m_layout     = 0;
+	unsigned m_nch        = 0;
+	unsigned m_samplerate = 0;
 
-public:
-	CAudioNormalizer();
-	virtual ~CAudioNormalizer();
+	biquad_t m_prefilter = {};
+	biquad_t m_rlbfilter = {};
+	float    m_tp_coefs[TP_TAPS][4] = {};
+	std::vector<channel_t> m_channels;
 
-	void SetParam(int Level, bool Boost, int Steping);
-	int Process(float *samples, unsigned numsamples, unsigned nch);
-};
+	// loudness meter, 100 ms blocks
+	unsigned m_block_size   = 0;
+	unsigned m_block_pos    = 0;
+	double   m_block_energy = 0.0;
+	double   m_energy[30]   = {};
+	unsigned m_energy_pos   = 0;
+	unsigned m_energy_count = 0;
 
-//
-// CAudioAutoVolume
-//
+	// normalization gain, interpolated over a block
+	double   m_gain_db     = 0.0;
+	float    m_gain        = 1.0f;
+	float    m_gain_target = 1.0f;
+	float    m_gain_step   = 0.0f;
 
-class CAudioAutoVolume
-{
-protected:
-	struct smooth_t {
-		double * data;
-		double max;
-		int size;
-		int used;
-		int current;
-	};
+	// lookahead limiter
+	unsigned m_attack      = 0; // frames
+	unsigned m_window      = 0; // frames, m_attack + true-peak interpolator lag
+	std::vector<float> m_delay;
+	unsigned m_delay_pos   = 0;
+	std::vector<std::pair<float, unsigned>> m_minqueue; // sliding minimum of the required gain
+	unsigned m_minqueue_head  = 0;
+	unsigned m_minqueue_count = 0;
+	std::vector<float> m_attack_buf;
+	unsigned m_attack_pos  = 0;
+	double   m_attack_sum  = 0.0;
+	float    m_lim_gain    = 1.0f;
+	float    m_lim_release = 0.0f;
+	unsigned m_frame       = 0;
+
+	void Init();
+	float TruePeak(channel_t& ch, const float x);
+	float LimiterGain(const float required);
+	void UpdateGain();
 
-	smooth_t *m_smooth[10] = {};
-	const double m_normalize_level = 0.25;
-	const double m_silence_level = 0.01;
-	const double m_max_mult = 5.0;
+public:
+	CAudioNormalizer();
 
-	const bool   m_do_compress = false;
-	const double m_cutoff = 13000.0;
-	const double m_degree = 2.0;
+	// Level - the highest peak, 0..100 % of full scale; RealeaseTime - seconds
+	void SetParam(int Level, bool Boost, int RealeaseTime);
+	void UpdateInput(uint32_t layout, unsigned samplerate);
+	void Flush();
 
-	void calc_power_level(float *samples, int numsamples, int nch);
-	void adjust_gain(float *samples, int numsamples, int nch, double gain);
-	smooth_t *SmoothNew(int size);
-	void SmoothDelete(smooth_t *del);
-	void SmoothAddSample(smooth_t *sm, double sample);
-	double SmoothGetMax(smooth_t *sm);
+	int Process(float *samples, unsigned numsamples, unsigned nch);
 
-public:
-	CAudioAutoVolume();
-	virtual ~CAudioAutoVolume();
+	unsigned GetTailSize() const;
+	int Drain(float *samples, unsigned nch);
 
-	int Process(float *samples, int numsamples, int nch);
+	REFERENCE_TIME GetDelay() const;
 };
@@ -84,6 +84,8 @@ void* __imp__aligned_free    = _aligned_free;
 #define AUDIO_GAIN_MAX    10.0
 #define AUDIO_GAIN_MIN    -3.0
 
+#define DSP_BLOCK_SIZE 4096 // samples of all channels per block, 16 KiB of float data
+
 static struct channel_mode_t {
 	const WORD channels;
 	const DWORD ch_layout;
@@ -261,6 +263,8 @@ HRESULT CAudioSwitcherFilter::Transform(IMediaSample* pIn, IMediaSample* pOut)
 		return E_FAIL;
 	}
 
+	m_ProcessingStats.nSamples += audio_samples;
+
 	const WAVEFORMATEX* output_wfe = (WAVEFORMATEX*)pOutPin->CurrentMediaType().pbFormat;
 	auto        &output_samplerate    = output_wfe->nSamplesPerSec;
 	auto        &output_channels      = output_wfe->nChannels;
@@ -292,7 +296,9 @@ HRESULT CAudioSwitcherFilter::Transform(IMediaSample* pIn, IMediaSample* pOut)
 		REFERENCE_TIME delay = m_Mixer.GetDelay();
 		rtStart -= delay;
 
+		const LONGLONG start = GetPerfCounter();
 		mix_samples = m_Mixer.Mixing(mix_data, mix_samples, audio_data, audio_samples);
+		m_ProcessingStats.rtStageTime[ASW_STAGE_MIXER] += GetPerfCounter() - start;
 
 		if (!mix_samples) {
 			pOut->SetActualDataLength(0);
@@ -307,45 +313,13 @@ HRESULT CAudioSwitcherFilter::Transform(IMediaSample* pIn, IMediaSample* pOut)
 		audio_sampleformat = SAMPLE_FMT_FLT;
 	}
 
-	// Bass redirect (works in place)
-	if ((m_bBassRedirect || input_layout == KSAUDIO_SPEAKER_STEREO) && CHL_CONTAINS_ALL(output_layout, SPEAKER_FRONT_LEFT|SPEAKER_FRONT_RIGHT|SPEAKER_LOW_FREQUENCY)) {
+	const bool bBassRedirect = (m_bBassRedirect || input_layout == KSAUDIO_SPEAKER_STEREO) && CHL_CONTAINS_ALL(output_layout, SPEAKER_FRONT_LEFT|SPEAKER_FRONT_RIGHT|SPEAKER_LOW_FREQUENCY);
+	if (bBassRedirect) {
 		m_BassRedirect.UpdateInput(audio_sampleformat, audio_layout, audio_samplerate);
-		m_BassRedirect.Process(audio_data, audio_samples);
-	}
-
-	// Auto volume control (works in place, requires float)
-	if (m_bAutoVolumeControl) {
-		if (audio_sampleformat != SAMPLE_FMT_FLT) {
-			m_buffer.ExpandSize(audio_allsamples);
-			convert_to_float(audio_sampleformat, audio_channels, audio_samples, audio_data, m_buffer.Data());
-
-			audio_data = (BYTE*)m_buffer.Data();
-			audio_sampleformat = SAMPLE_FMT_FLT;
-		}
-		audio_samples    = m_AudioNormalizer.Process((float*)audio_data, audio_samples, audio_channels);
-		audio_allsamples = audio_samples * audio_channels;
-	}
-	// Gain (works in place)
-	else if (m_dGainFactor != 1.0) {
-		switch (audio_sampleformat) {
-		case SAMPLE_FMT_U8:
-			gain_uint8(m_dGainFactor, audio_allsamples, (uint8_t*)audio_data);
-			break;
-		case SAMPLE_FMT_S16:
-			gain_int16(m_dGainFactor, audio_allsamples, (int16_t*)audio_data);
-			break;
-		case SAMPLE_FMT_S24:
-			gain_int24(m_dGainFactor, audio_allsamples, audio_data);
-			break;
-		case SAMPLE_FMT_S32:
-			gain_int32(m_dGainFactor, audio_allsamples, (int32_t*)audio_data);
-			break;
-		case SAMPLE_FMT_FLT:
-			gain_float(m_dGainFactor, audio_allsamples, (float*)audio_data);
-			break;
-		}
 	}
+	const bool bGain = !m_bAutoVolumeControl && m_dGainFactor != 1.0;
 
+	bool bAudioFilter = false;
 	if (m_afilters.size()) {
 		hr = S_FALSE;
 		if (!m_AudioFilter.IsInitialized()) {
@@ -355,47 +329,74 @@ HRESULT CAudioSwitcherFilter::Transform(IMediaSample* pIn, IMediaSample* pOut)
 				true, m_afilters
 			);
 		}
-		if (SUCCEEDED(hr)) {
+		bAudioFilter = SUCCEEDED(hr);
+	}
+
+	// Bass redirect, gain and conversion work block by block. The auto volume control
+	// and the audio filter need the whole buffer in float, so in that case the blocks
+	// are converted to float and the conversion to output is done at the end.
+	{
+		BYTE* dst_data = audio_data;
+		SampleFormat dst_sampleformat = audio_sampleformat;
+
+		if (m_bAutoVolumeControl || bAudioFilter) {
 			if (audio_sampleformat != SAMPLE_FMT_FLT) {
 				m_buffer.ExpandSize(audio_allsamples);
-				convert_to_float(audio_sampleformat, audio_channels, audio_samples, audio_data, m_buffer.Data());
-
-				audio_data = (BYTE*)m_buffer.Data();
-				audio_sampleformat = SAMPLE_FMT_FLT;
+				dst_data = (BYTE*)m_buffer.Data();
+				dst_sampleformat = SAMPLE_FMT_FLT;
+			}
+		}
+		else if (audio_data != pDataOut) {
+			if (audio_samples > output_samplesize) {
+				return E_FAIL;
 			}
+			dst_data = pDataOut;
+			dst_sampleformat = output_sampleformat;
+		}
 
-			hr = m_AudioFilter.Push(rtStart, audio_data, audio_allsamples * 4);
-			if (SUCCEEDED(hr)) {
-				hr = m_AudioFilter.Pull(rtStart, m_buffer, audio_allsamples);
-				if (hr == E_PENDING) {
-					pOut->SetActualDataLength(0);
-					return S_OK;
-				}
-				audio_data = (BYTE*)m_buffer.Data();
-				audio_samples = audio_allsamples / audio_channels;
+		hr = ProcessBlocks(audio_data, audio_sampleformat, dst_data, dst_sampleformat, audio_channels, audio_samples, bBassRedirect, bGain);
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		audio_data = dst_data;
+		audio_sampleformat = dst_sampleformat;
+	}
+
+	// Auto volume control (works in place, requires float)
+	if (m_bAutoVolumeControl) {
+		m_AudioNormalizer.UpdateInput(audio_layout, audio_samplerate);
+		rtStart -= m_AudioNormalizer.GetDelay();
+
+		const LONGLONG start = GetPerfCounter();
+		audio_samples    = m_AudioNormalizer.Process((float*)audio_data, audio_samples, audio_channels);
+		audio_allsamples = audio_samples * audio_channels;
+		m_ProcessingStats.rtStageTime[ASW_STAGE_NORMALIZER] += GetPerfCounter() - start;
+	}
+
+	if (bAudioFilter) {
+		const LONGLONG start = GetPerfCounter();
+		hr = m_AudioFilter.Push(rtStart, audio_data, audio_allsamples * 4);
+		if (SUCCEEDED(hr)) {
+			hr = m_AudioFilter.Pull(rtStart, m_buffer, audio_allsamples);
+			m_ProcessingStats.rtStageTime[ASW_STAGE_FILTER] += GetPerfCounter() - start;
+			if (hr == E_PENDING) {
+				pOut->SetActualDataLength(0);
+				return S_OK;
 			}
+			audio_data = (BYTE*)m_buffer.Data();
+			audio_samples = audio_allsamples / audio_channels;
 		}
 	}
 
 	// Copy or convert to output
-	if (audio_data != pDataOut && audio_samples > output_samplesize) {
-		return E_FAIL;
-	}
 	if (audio_data != pDataOut) {
-		switch (output_sampleformat) {
-		case SAMPLE_FMT_S16:
-			m_DitherInt16.UpdateInput(audio_sampleformat, audio_channels);
-			m_DitherInt16.Process((int16_t*)pDataOut, audio_data, audio_samples);
-			break;
-		case SAMPLE_FMT_S24:
-			hr = convert_to_int24(audio_sampleformat, audio_channels, audio_samples, audio_data, pDataOut);
-			break;
-		case SAMPLE_FMT_S32:
-			hr = convert_to_int32(audio_sampleformat, audio_channels, audio_samples, audio_data, (int32_t*)pDataOut);
-			break;
-		case SAMPLE_FMT_FLT:
-			hr = convert_to_float(audio_sampleformat, audio_channels, audio_samples, audio_data, (float*)pDataOut);
-			break;
+		if (audio_samples > output_samplesize) {
+			return E_FAIL;
+		}
+		hr = ProcessBlocks(audio_data, audio_sampleformat, pDataOut, output_sampleformat, audio_channels, audio_samples, false, false);
+		if (FAILED(hr)) {
+			return hr;
 		}
 		audio_sampleformat = output_sampleformat;
 	}
@@ -413,6 +414,90 @@ HRESULT CAudioSwitcherFilter::Transform(IMediaSample* pIn, IMediaSample* pOut)
 	return S_OK;
 }
 
+HRESULT CAudioSwitcherFilter::ProcessBlocks(BYTE* src, const SampleFormat src_sf, BYTE* dst, const SampleFormat dst_sf, const unsigned channels, const int samples, const bool bBassRedirect, const bool bGain)
+{
+	const bool bConvert = (dst != src);
+	if (!bBassRedirect && !bGain && !bConvert) {
+		return S_OK;
+	}
+
+	if (bConvert && dst_sf == SAMPLE_FMT_S16) {
+		m_DitherInt16.UpdateInput(src_sf, channels);
+	}
+
+	const size_t src_framesize = channels * get_bytes_per_sample(src_sf);
+	const size_t dst_framesize = channels * get_bytes_per_sample(dst_sf);
+	const int    block_samples = std::max(1u, DSP_BLOCK_SIZE / channels);
+
+	LONGLONG time = GetPerfCounter();
+	auto UpdateStageTime = [&](const int stage) {
+		const LONGLONG now = GetPerfCounter();
+		m_ProcessingStats.rtStageTime[stage] += now - time;
+		time = now;
+	};
+
+	for (int pos = 0; pos < samples; pos += block_samples) {
+		const int    count    = std::min(block_samples, samples - pos);
+		const size_t allcount = (size_t)count * channels;
+		BYTE* src_block = src + pos * src_framesize;
+		BYTE* dst_block = dst + pos * dst_framesize;
+
+		// Bass redirect (works in place)
+		if (bBassRedirect) {
+			m_BassRedirect.Process(src_block, count);
+			UpdateStageTime(ASW_STAGE_BASSREDIRECT);
+		}
+
+		// Gain (works in place)
+		if (bGain) {
+			switch (src_sf) {
+			case SAMPLE_FMT_U8:
+				gain_uint8(m_dGainFactor, allcount, (uint8_t*)src_block);
+				break;
+			case SAMPLE_FMT_S16:
+				gain_int16(m_dGainFactor, allcount, (int16_t*)src_block);
+				break;
+			case SAMPLE_FMT_S24:
+				gain_int24(m_dGainFactor, allcount, src_block);
+				break;
+			case SAMPLE_FMT_S32:
+				gain_int32(m_dGainFactor, allcount, (int32_t*)src_block);
+				break;
+			case SAMPLE_FMT_FLT:
+				gain_float(m_dGainFactor, allcount, (float*)src_block);
+				break;
+			}
+			UpdateStageTime(ASW_STAGE_GAIN);
+		}
+
+		if (bConvert) {
+			HRESULT hr = S_OK;
+			switch (dst_sf) {
+			case SAMPLE_FMT_S16:
+				m_DitherInt16.Process((int16_t*)dst_block, src_block, count);
+				break;
+			case SAMPLE_FMT_S24:
+				hr = convert_to_int24(src_sf, channels, count, src_block, dst_block);
+				break;
+			case SAMPLE_FMT_S32:
+				hr = convert_to_int32(src_sf, channels, count, src_block, (int32_t*)dst_block);
+				break;
+			case SAMPLE_FMT_FLT:
+				hr = convert_to_float(src_sf, channels, count, src_block, (float*)dst_block);
+				break;
+			}
+			UpdateStageTime(ASW_STAGE_CONVERT);
+			if (FAILED(hr)) {
+				return hr;
+			}
+		}
+
+		m_ProcessingStats.nBlocks++;
+	}
+
+	return S_OK;
+}
+
 void CAudioSwitcherFilter::TransformMediaType(CMediaType& mt, const bool bForce16Bit/* = false*/)
 {
 	if (mt.majortype == MEDIATYPE_Audio
@@ -541,11 +626,75 @@ void CAudioSwitcherFilter::TransformMediaType(CMediaType& mt, const bool bForce1
 	}
 }
 
+void CAudioSwitcherFilter::DeliverNormalizerTail()
+{
+	CAutoLock cAutoLock(&m_csTransform);
+
+	if (!m_bAutoVolumeControl || !m_AudioNormalizer.GetTailSize()) {
+		return;
+	}
+
+	CStreamSwitcherOutputPin* pOutPin = GetOutputPin();
+	const WAVEFORMATEX* output_wfe = pOutPin && pOutPin->IsConnected() ? (WAVEFORMATEX*)pOutPin->CurrentMediaType().pbFormat : nullptr;
+	const SampleFormat output_sampleformat = output_wfe ? GetSampleFormat(output_wfe) : SAMPLE_FMT_NONE;
+	if (output_sampleformat == SAMPLE_FMT_NONE) {
+		m_AudioNormalizer.Flush();
+		return;
+	}
+
+	// the normalizer works after the mixer, so the tail is already in the output layout
+	const unsigned audio_channels = output_wfe->nChannels;
+	m_buffer.ExpandSize(m_AudioNormalizer.GetTailSize() * audio_channels);
+	int audio_samples = m_AudioNormalizer.Drain(m_buffer.Data(), audio_channels);
+	unsigned audio_allsamples = audio_samples * audio_channels;
+	if (!audio_samples) {
+		return;
+	}
+
+	REFERENCE_TIME rtStart = m_rtNextStart;
+	if (m_AudioFilter.IsInitialized()) {
+		if (FAILED(m_AudioFilter.Push(rtStart, (BYTE*)m_buffer.Data(), audio_allsamples * 4))
+				|| m_AudioFilter.Pull(rtStart, m_buffer, audio_allsamples) != S_OK) {
+			return;
+		}
+		audio_samples = audio_allsamples / audio_channels;
+	}
+
+	CComPtr<IMediaSample> pOutSample;
+	BYTE* pDataOut = nullptr;
+	if (FAILED(pOutPin->GetDeliveryBuffer(&pOutSample, nullptr, nullptr, 0))
+			|| FAILED(pOutSample->GetPointer(&pDataOut))
+			|| (long)(audio_allsamples * get_bytes_per_sample(output_sampleformat)) > pOutSample->GetSize()
+			|| FAILED(ProcessBlocks((BYTE*)m_buffer.Data(), SAMPLE_FMT_FLT, pDataOut, output_sampleformat, audio_channels, audio_samples, false, false))) {
+		return;
+	}
+
+	pOutSample->SetActualDataLength(audio_allsamples * get_bytes_per_sample(output_sampleformat));
+
+	REFERENCE_TIME rtStop = rtStart + 10000000i64 * audio_samples / output_wfe->nSamplesPerSec;
+	m_rtNextStart = rtStop;
+
+	rtStart += m_rtAudioTimeShift / m_dRate;
+	rtStop  += m_rtAudioTimeShift / m_dRate;
+	pOutSample->SetTime(&rtStart, &rtStop);
+
+	pOutPin->Deliver(pOutSample);
+}
+
+HRESULT CAudioSwitcherFilter::DeliverEndOfStream()
+{
+	// output the samples still held in the lookahead of the normalizer
+	DeliverNormalizerTail();
+
+	return __super::DeliverEndOfStream();
+}
+
 HRESULT CAudioSwitcherFilter::DeliverNewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop, double dRate)
 {
 	CAutoLock cAutoLock(&m_csTransform);
 
 	m_AudioFilter.Flush();
+	m_AudioNormalizer.Flush();
 
 	return __super::DeliverNewSegment(tStart, tStop, dRate);
 }
@@ -773,6 +922,17 @@ STDMETHODIMP_(int) CAudioSwitcherFilter::GetAudioFilterState()
 	}
 }
 
+STDMETHODIMP CAudioSwitcherFilter::GetProcessingStats(AudioProcessingStats* pStats)
+{
+	CheckPointer(pStats, E_POINTER);
+
+	CAutoLock cAutoLock(&m_csTransform);
+
+	*pStats = m_ProcessingStats;
+
+	return S_OK;
+}
+
 // IAMStreamSelect
 
 STDMETHODIMP CAudioSwitcherFilter::Enable(long lIndex, DWORD dwFlags)
@@ -74,8 +74,13 @@ class __declspec(uuid("18C16B08-6497-420e-AD14-22D21C2CEAB7"))
 
 	REFERENCE_TIME m_rtNextStart;
 
+	AudioProcessingStats m_ProcessingStats = {};
+
 	void CheckSupportedOutputMediaType() override;
 
+	void DeliverNormalizerTail();
+	HRESULT ProcessBlocks(BYTE* src, const SampleFormat src_sf, BYTE* dst, const SampleFormat dst_sf, const unsigned channels, const int samples, const bool bBassRedirect, const bool bGain);
+
 public:
 	CAudioSwitcherFilter(LPUNKNOWN lpunk, HRESULT* phr);
 	~CAudioSwitcherFilter();
@@ -83,6 +88,7 @@ public:
 	HRESULT CheckMediaType(const CMediaType* pmt) override;
 	HRESULT Transform(IMediaSample* pIn, IMediaSample* pOut) override;
 	void TransformMediaType(CMediaType& mt, const bool bForce16Bit = false) override;
+	HRESULT DeliverEndOfStream() override;
 	HRESULT DeliverNewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop, double dRate) override;
 
 	DECLARE_IUNKNOWN
@@ -99,6 +105,7 @@ public:
 	STDMETHODIMP SetAudioTimeShift(REFERENCE_TIME rtAudioTimeShift);
 	STDMETHODIMP SetAudioFilter1(const char* str_filter);
 	STDMETHODIMP_(int) GetAudioFilterState();
+	STDMETHODIMP GetProcessingStats(AudioProcessingStats* pStats);
 
 	// IAMStreamSelect
 	STDMETHODIMP Enable(long lIndex, DWORD dwFlags);
@@ -38,6 +38,22 @@ enum {
 	SPK_7_1
 };
 
+enum {
+	ASW_STAGE_MIXER = 0,
+	ASW_STAGE_BASSREDIRECT,
+	ASW_STAGE_GAIN,
+	ASW_STAGE_NORMALIZER,
+	ASW_STAGE_FILTER,
+	ASW_STAGE_CONVERT,
+	ASW_STAGE_COUNT
+};
+
+struct AudioProcessingStats {
+	UINT64         nSamples;                     // input samples (per channel)
+	UINT64         nBlocks;                      // blocks passed through the block processing
+	REFERENCE_TIME rtStageTime[ASW_STAGE_COUNT]; // accumulated time of each stage, in 100 ns units
+};
+
 interface __declspec(uuid("CEDB2890-53AE-4231-91A3-B0AAFCD1DBDE"))
 IAudioSwitcherFilter :
 public IUnknown {
@@ -51,4 +67,5 @@ public IUnknown {
 	STDMETHOD(SetAudioTimeShift) (REFERENCE_TIME rtAudioTimeShift) PURE;
 	STDMETHOD(SetAudioFilter1)(const char* str_filter) PURE;
 	STDMETHOD_(int, GetAudioFilterState)() PURE;
+	STDMETHOD(GetProcessingStats)(AudioProcessingStats* pStats) PURE;
 };
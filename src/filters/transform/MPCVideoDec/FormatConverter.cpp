@@ -550,6 +550,30 @@ bool CFormatConverter::DirectCopyPossible(const AVPixelFormat avformat)
 		   avformat == AV_PIX_FMT_YUV444P16 && m_out_pixfmt == PixFmt_YUV444P16;
 }
 
+// fills the planes of the output buffer for a frame that can be written to it without conversion
+bool CFormatConverter::GetDirectPlanes(BYTE* dst, const AVPixelFormat avformat, uint8_t* data[4], int linesize[4])
+{
+	if (!DirectCopyPossible(avformat)) {
+		return false;
+	}
+
+	const SW_OUT_FMT& swof = s_sw_formats[m_out_pixfmt];
+	const int byteStride = m_dstStride * swof.codedbytes;
+
+	BYTE* plane = dst;
+	for (int i = 0; i < swof.planes; i++) {
+		data[i]     = plane;
+		linesize[i] = byteStride / swof.planeWidth[i];
+		plane += linesize[i] * (m_planeHeight / swof.planeHeight[i]);
+	}
+
+	if (m_out_pixfmt == PixFmt_YV24) {
+		std::swap(data[1], data[2]); // swap UV when YUV444P to YV24
+	}
+
+	return true;
+}
+
 void CFormatConverter::Clear()
 {
 	m_FProps = {};
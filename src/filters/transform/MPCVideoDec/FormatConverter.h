@@ -198,8 +198,10 @@ public:
 	bool FormatChanged(AVPixelFormat* fmt1, AVPixelFormat* fmt2);
 
 	bool DirectCopyPossible(AVPixelFormat avformat);
+	bool GetDirectPlanes(BYTE* dst, AVPixelFormat avformat, uint8_t* data[4], int linesize[4]);
 
 	int GetDstStride() const { return m_dstStride; }
+	int GetPlaneHeight() const { return m_planeHeight; }
 
 	void Clear();
 };
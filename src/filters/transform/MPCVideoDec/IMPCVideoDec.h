@@ -126,6 +126,25 @@ struct MPC_ADAPTER_ID {
 	UINT DeviceId;
 };
 
+enum MPCThreadingType : int {
+	THREADING_NONE = 0,
+	THREADING_FRAME,
+	THREADING_SLICE
+};
+
+struct MPC_DECODE_STATS {
+	MPCThreadingType ThreadingType;
+	int              ThreadCount;
+	bool             bLowLatency;      // live source, slice threading is preferred
+	REFERENCE_TIME   rtLastDecodeTime; // decoding time of the last packet
+	REFERENCE_TIME   rtAvgDecodeTime;  // average decoding time
+	REFERENCE_TIME   rtFrameDuration;
+	UINT64           nPacketsWrapped;  // input packets decoded from the sample memory
+	UINT64           nPacketsCopied;   // input packets copied to a padded buffer
+	UINT64           nBytesCopied;
+	UINT64           nFramesDirect;    // frames decoded directly into the output sample
+};
+
 interface __declspec(uuid("CDC3B5B3-A8B0-4c70-A805-9FC80CDEF262"))
 IMPCVideoDecFilter :
 public IUnknown {
@@ -166,4 +185,6 @@ public IUnknown {
 
 	STDMETHOD(GetD3D11Adapter(MPC_ADAPTER_ID* pAdapterId)) PURE;
 	STDMETHOD(SetD3D11Adapter(UINT VendorId, UINT DeviceId)) PURE;
+
+	STDMETHOD(GetDecodeStats(MPC_DECODE_STATS* pStats)) PURE;
 };
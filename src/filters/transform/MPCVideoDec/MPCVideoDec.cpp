@@ -47,6 +47,7 @@
 extern "C" {
 	#include <ExtLib/ffmpeg/libavcodec/avcodec.h>
 	#include <ExtLib/ffmpeg/libavcodec/dxva2.h>
+	#include <ExtLib/ffmpeg/libavutil/cpu.h>
 	#include <ExtLib/ffmpeg/libavutil/intreadwrite.h>
 	#include <ExtLib/ffmpeg/libavutil/imgutils.h>
 	#include <ExtLib/ffmpeg/libavutil/mastering_display_metadata.h>
@@ -1044,6 +1045,7 @@ CMPCVideoDecFilter::CMPCVideoDecFilter(LPUNKNOWN lpunk, HRESULT* phr)
 	, m_pAVCodec(nullptr)
 	, m_pAVCtx(nullptr)
 	, m_pFrame(nullptr)
+	, m_pPacket(nullptr)
 	, m_pParser(nullptr)
 	, m_CodecId(AV_CODEC_ID_NONE)
 	, m_bCalculateStopTime(false)
@@ -1252,6 +1254,8 @@ CMPCVideoDecFilter::~CMPCVideoDecFilter()
 {
 	Cleanup();
 	SAFE_DELETE(m_pD3D11Decoder);
+
+	av_packet_free(&m_pPacket);
 }
 
 void CMPCVideoDecFilter::DetectVideoCard(HWND hWnd)
@@ -1620,6 +1624,12 @@ void CMPCVideoDecFilter::CleanupDXVAVariables()
 
 void CMPCVideoDecFilter::CleanupFFmpeg()
 {
+	DLogIf(m_nPacketsWrapped || m_nPacketsCopied, L"CMPCVideoDecFilter::CleanupFFmpeg() : input packets - %I64u wrapped, %I64u copied (%I64u bytes)",
+		   m_nPacketsWrapped, m_nPacketsCopied, m_nBytesCopied);
+	DLogIf(m_nFramesDirect, L"CMPCVideoDecFilter::CleanupFFmpeg() : %I64u frames decoded directly into the output samples", m_nFramesDirect);
+
+	ReleaseDirectSample();
+
 	m_pAVCodec = nullptr;
 
 	av_parser_close(m_pParser);
@@ -1919,8 +1929,15 @@ redo:
 		ExtractDim(pmt, wout, hout, m_nARX, m_nARY);
 		UNREFERENCED_PARAMETER(wout);
 		UNREFERENCED_PARAMETER(hout);
+
+		m_bLowLatency        = IsLiveSource();
+		m_bForceFrameThreads = false;
 	}
 
+	m_bThreadsReinit   = false;
+	m_nDecodeTimeCount = 0;
+	m_rtLastDecodeTime = m_rtAvgDecodeTime = 0;
+
 	m_bMVC_Output_TopBottom = FALSE;
 	if (pmt->subtype == MEDIASUBTYPE_AMVC || pmt->subtype == MEDIASUBTYPE_MVC1) {
 		if (!m_pMSDKDecoder) {
@@ -2066,11 +2083,18 @@ redo:
 		m_pParser = av_parser_init(m_CodecId);
 	}
 
-	SetThreadCount();
-
 	m_pFrame = av_frame_alloc();
 	CheckPointer(m_pFrame, E_POINTER);
 
+	if (!m_pPacket) {
+		m_pPacket = av_packet_alloc();
+		CheckPointer(m_pPacket, E_POINTER);
+	}
+	m_bZeroCopyPacket = true;
+	m_nPacketsWrapped = m_nPacketsCopied = m_nBytesCopied = 0;
+	m_nFramesDirect = 0;
+	m_bDirectRendering = false;
+
 	BITMAPINFOHEADER *pBMI = nullptr;
 	bool bInterlacedFieldPerSample = false;
 	m_inputDxvaExtFormat.value = 0;
@@ -2127,6 +2151,8 @@ redo:
 	m_pAVCtx->skip_frame            = (AVDiscard)m_nDiscardMode;
 	m_pAVCtx->opaque                = this;
 
+	SetThreadCount();
+
 	if (IsDXVASupported(m_bUseD3D11)) {
 		m_pD3D11Decoder->AdditionaDecoderInit(m_pAVCtx);
 	} else if (IsDXVASupported(m_bUseDXVA)) {
@@ -2156,6 +2182,13 @@ redo:
 			m_pAVCtx->get_format = av_get_format;
 			m_pAVCtx->hw_device_ctx = av_buffer_ref(m_HWDeviceCtx);
 		}
+	} else {
+		// intra-only codecs output each frame right after decoding it, so it can be decoded directly into the output sample
+		const AVCodecDescriptor* desc = avcodec_descriptor_get(m_CodecId);
+		if (desc && (desc->props & AV_CODEC_PROP_INTRA_ONLY)) {
+			m_pAVCtx->get_buffer2   = av_get_buffer_direct;
+			m_bDirectRendering      = true;
+		}
 	}
 
 	AllocExtradata(pmt);
@@ -2938,6 +2971,9 @@ HRESULT CMPCVideoDecFilter::DecideBufferSize(IMemAllocator* pAllocator, ALLOCATO
 
 HRESULT CMPCVideoDecFilter::BeginFlush()
 {
+	// do not hold an output sample while the renderer flushes
+	ReleaseDirectSample();
+
 	return __super::BeginFlush();
 }
 
@@ -2949,6 +2985,7 @@ HRESULT CMPCVideoDecFilter::EndFlush()
 	if (m_pAVCtx && avcodec_is_open(m_pAVCtx)) {
 		avcodec_flush_buffers(m_pAVCtx);
 	}
+	ReleaseDirectSample();
 
 	return hr;
 }
@@ -2962,6 +2999,7 @@ HRESULT CMPCVideoDecFilter::NewSegment(REFERENCE_TIME rtStart, REFERENCE_TIME rt
 	if (m_pAVCtx) {
 		avcodec_flush_buffers(m_pAVCtx);
 	}
+	ReleaseDirectSample();
 
 	if (m_pParser) {
 		av_parser_close(m_pParser);
@@ -3021,6 +3059,14 @@ HRESULT CMPCVideoDecFilter::BreakConnect(PIN_DIRECTION dir)
 	return __super::BreakConnect(dir);
 }
 
+HRESULT CMPCVideoDecFilter::StopStreaming()
+{
+	// the output allocator is decommitted
+	ReleaseDirectSample();
+
+	return __super::StopStreaming();
+}
+
 void CMPCVideoDecFilter::SetTypeSpecificFlags(IMediaSample* pMS)
 {
 	if (CComQIPtr<IMediaSample2> pMS2 = pMS) {
@@ -3268,8 +3314,39 @@ static inline BOOL GOPFound(BYTE *buf, int len)
 	return FALSE;
 }
 
-HRESULT CMPCVideoDecFilter::FillAVPacket(AVPacket *avpkt, const BYTE *buffer, int buflen)
+static void ReleaseMediaSample(void* opaque, uint8_t* data)
+{
+	static_cast<IMediaSample*>(opaque)->Release();
+}
+
+HRESULT CMPCVideoDecFilter::FillAVPacket(AVPacket *avpkt, const BYTE *buffer, int buflen, IMediaSample* pSample/* = nullptr*/)
 {
+	// Wrap the sample memory without copying if it already has the zeroed padding required by FFmpeg.
+	// The sample buffer belongs to the upstream allocator, so the padding is never written here.
+	// The sample is kept alive by the packet buffer, so this is only done when the decoder does not hold packets
+	// between calls (frame threading), otherwise the upstream allocator may run out of samples.
+	if (pSample && m_bZeroCopyPacket
+			&& m_CodecId != AV_CODEC_ID_PRORES
+			&& m_pAVCtx->active_thread_type != FF_THREAD_FRAME) {
+		BYTE* pData = nullptr;
+		if (SUCCEEDED(pSample->GetPointer(&pData))
+				&& buffer >= pData && buffer + buflen + AV_INPUT_BUFFER_PADDING_SIZE <= pData + pSample->GetSize()) {
+			static const BYTE zeroPadding[AV_INPUT_BUFFER_PADDING_SIZE] = {};
+			if (memcmp(buffer + buflen, zeroPadding, AV_INPUT_BUFFER_PADDING_SIZE) == 0) {
+				avpkt->buf = av_buffer_create((uint8_t*)buffer, buflen + AV_INPUT_BUFFER_PADDING_SIZE, ReleaseMediaSample, pSample, AV_BUFFER_FLAG_READONLY);
+				if (avpkt->buf) {
+					pSample->AddRef();
+
+					avpkt->data = avpkt->buf->data;
+					avpkt->size = buflen;
+
+					m_nPacketsWrapped++;
+					return S_OK;
+				}
+			}
+		}
+	}
+
 	int size = buflen;
 	if (m_CodecId == AV_CODEC_ID_PRORES) {
 		// code from ffmpeg/libavutil/mem.c -> av_fast_realloc()
@@ -3284,6 +3361,8 @@ HRESULT CMPCVideoDecFilter::FillAVPacket(AVPacket *avpkt, const BYTE *buffer, in
 		memset(avpkt->data + buflen, 0, size - buflen);
 	}
 
+	m_nPacketsCopied++;
+	m_nBytesCopied += buflen;
 	return S_OK;
 }
 
@@ -3316,7 +3395,13 @@ HRESULT CMPCVideoDecFilter::DecodeInternal(AVPacket *avpkt, REFERENCE_TIME rtSta
 		}
 	}
 
+	if (avpkt && m_pAVCtx->get_buffer2 == av_get_buffer_direct) {
+		PrepareDirectSample();
+	}
+
+	const REFERENCE_TIME rtSendStart = GetPerfCounter();
 	int ret = avcodec_send_packet(m_pAVCtx, avpkt);
+	m_rtDecodeTimeSum += GetPerfCounter() - rtSendStart;
 	if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
 		if (UseDXVA2() && (!m_bDXVACompatible || m_bFailDXVA2Decode)) {
 			CleanupDXVAVariables();
@@ -3350,11 +3435,13 @@ HRESULT CMPCVideoDecFilter::DecodeInternal(AVPacket *avpkt, REFERENCE_TIME rtSta
 	for (;;) {
 		AVFrame* hw_frame = (m_HWPixFmt != AV_PIX_FMT_NONE) ? av_frame_alloc() : nullptr;
 
+		const REFERENCE_TIME rtReceiveStart = GetPerfCounter();
 		if (m_HWPixFmt == AV_PIX_FMT_NONE) {
 			ret = avcodec_receive_frame(m_pAVCtx, m_pFrame);
 		} else {
 			ret = avcodec_receive_frame(m_pAVCtx, hw_frame);
 		}
+		m_rtDecodeTimeSum += GetPerfCounter() - rtReceiveStart;
 		if (ret < 0 && ret != AVERROR(EAGAIN)) {
 			av_frame_unref(m_pFrame);
 			av_frame_free(&hw_frame);
@@ -3473,19 +3560,32 @@ HRESULT CMPCVideoDecFilter::DecodeInternal(AVPacket *avpkt, REFERENCE_TIME rtSta
 			CLEAR_AND_CONTINUE;
 		}
 
-		CComPtr<IMediaSample> pOut;
+		// the frame may have been decoded directly into the output sample
+		CComPtr<IMediaSample> pOut = GetDirectSample(m_pFrame);
+		const bool bDirectSample = (pOut != nullptr);
 		BYTE* pDataOut = nullptr;
-		DXVA2_ExtendedFormat dxvaExtFormat = GetDXVA2ExtendedFormat(m_pAVCtx, m_pFrame);
 
-		int w = m_pAVCtx->width;
-		int h = m_pAVCtx->height;
-		FixFrameSize(m_pAVCtx, w, h);
+		if (bDirectSample) {
+			m_nFramesDirect++;
+		} else {
+			// the requested sample was not used, it may carry a format change and the allocator may have no other one
+			ReleaseDirectSample();
 
-		if (FAILED(hr = GetDeliveryBuffer(w, h, &pOut, GetFrameDuration(), &dxvaExtFormat)) || FAILED(hr = pOut->GetPointer(&pDataOut))) {
-			CLEAR_AND_CONTINUE;
+			DXVA2_ExtendedFormat dxvaExtFormat = GetDXVA2ExtendedFormat(m_pAVCtx, m_pFrame);
+
+			int w = m_pAVCtx->width;
+			int h = m_pAVCtx->height;
+			FixFrameSize(m_pAVCtx, w, h);
+
+			if (FAILED(hr = GetDeliveryBuffer(w, h, &pOut, GetFrameDuration(), &dxvaExtFormat)) || FAILED(hr = pOut->GetPointer(&pDataOut))) {
+				CLEAR_AND_CONTINUE;
+			}
 		}
 
-		if (hw_frame && hw_frame->hw_frames_ctx) {
+		if (bDirectSample) {
+			// nothing to do, the decoder has written the picture to the output sample
+		}
+		else if (hw_frame && hw_frame->hw_frames_ctx) {
 			auto frames_ctx = (AVHWFramesContext*)hw_frame->hw_frames_ctx->data;
 
 			if (frames_ctx->format == AV_PIX_FMT_D3D11) {
@@ -3701,9 +3801,8 @@ HRESULT CMPCVideoDecFilter::ParseInternal(const BYTE *buffer, int buflen, REFERE
 		}
 
 		if (pOutLen > 0) {
-			AVPacket *avpkt = av_packet_alloc();
+			AVPacket *avpkt = m_pPacket;
 			if (FAILED(hr = FillAVPacket(avpkt, pOutBuffer, pOutLen))) {
-				av_packet_free(&avpkt);
 				break;
 			}
 
@@ -3711,7 +3810,7 @@ HRESULT CMPCVideoDecFilter::ParseInternal(const BYTE *buffer, int buflen, REFERE
 
 			hr = DecodeInternal(avpkt, rtStartIn, rtStopIn, bPreroll);
 
-			av_packet_free(&avpkt);
+			av_packet_unref(avpkt);
 
 			if (FAILED(hr)) {
 				break;
@@ -3725,7 +3824,7 @@ HRESULT CMPCVideoDecFilter::ParseInternal(const BYTE *buffer, int buflen, REFERE
 	return hr;
 }
 
-HRESULT CMPCVideoDecFilter::Decode(const BYTE *buffer, int buflen, REFERENCE_TIME rtStartIn, REFERENCE_TIME rtStopIn, BOOL bSyncPoint/* = FALSE*/, BOOL bPreroll/* = FALSE*/)
+HRESULT CMPCVideoDecFilter::Decode(const BYTE *buffer, int buflen, REFERENCE_TIME rtStartIn, REFERENCE_TIME rtStopIn, BOOL bSyncPoint/* = FALSE*/, BOOL bPreroll/* = FALSE*/, IMediaSample* pSample/* = nullptr*/)
 {
 	HRESULT hr = S_OK;
 
@@ -3735,6 +3834,15 @@ HRESULT CMPCVideoDecFilter::Decode(const BYTE *buffer, int buflen, REFERENCE_TIM
 		m_nBFramePos = !m_nBFramePos;
 	}
 
+	if (m_bThreadsReinit && bSyncPoint && buffer) {
+		// output the frames buffered by the decoder, then recreate it with the new threading
+		DecodeInternal(nullptr, INVALID_TIME, INVALID_TIME);
+		InitDecoder(&m_pCurrentMediaType);
+	}
+
+	// only the time spent in the decoder is counted, waiting for the output samples and the delivery are not
+	m_rtDecodeTimeSum = 0;
+
 	if (m_pParser) {
 		hr = ParseInternal(buffer, buflen, rtStartIn, rtStopIn, bPreroll);
 	} else {
@@ -3742,9 +3850,8 @@ HRESULT CMPCVideoDecFilter::Decode(const BYTE *buffer, int buflen, REFERENCE_TIM
 			return DecodeInternal(nullptr, INVALID_TIME, INVALID_TIME);
 		}
 
-		AVPacket *avpkt = av_packet_alloc();
-		if (FAILED(FillAVPacket(avpkt, buffer, buflen))) {
-			av_packet_free(&avpkt);
+		AVPacket *avpkt = m_pPacket;
+		if (FAILED(FillAVPacket(avpkt, buffer, buflen, pSample))) {
 			return E_OUTOFMEMORY;
 		}
 
@@ -3756,7 +3863,17 @@ HRESULT CMPCVideoDecFilter::Decode(const BYTE *buffer, int buflen, REFERENCE_TIM
 
 		hr = DecodeInternal(avpkt, rtStartIn, rtStopIn, bPreroll);
 
-		av_packet_free(&avpkt);
+		if (m_bZeroCopyPacket && avpkt->buf && av_buffer_get_ref_count(avpkt->buf) > 1) {
+			// the decoder keeps the packet data, do not hold the input samples anymore
+			DLog(L"CMPCVideoDecFilter::Decode() : decoder holds input packets, zero-copy input disabled");
+			m_bZeroCopyPacket = false;
+		}
+
+		av_packet_unref(avpkt);
+	}
+
+	if (m_rtDecodeTimeSum > 0) {
+		UpdateDecodeTime(m_rtDecodeTimeSum);
 	}
 
 	return hr;
@@ -3813,19 +3930,84 @@ HRESULT CMPCVideoDecFilter::ChangeOutputMediaFormat(int nType)
 	return hr;
 }
 
+// capture devices and other live sources expose IAMPushSource on the filter or its output pin
+bool CMPCVideoDecFilter::IsLiveSource()
+{
+	IPin* pPin = m_pInput->GetConnected();
+	while (pPin) {
+		CComPtr<IBaseFilter> pBF = GetFilterFromPin(pPin);
+
+		CComQIPtr<IAMPushSource> pPushSource = pPin;
+		if (!pPushSource && pBF) {
+			pPushSource = pBF;
+		}
+		if (pPushSource) {
+			ULONG flags = 0;
+			return FAILED(pPushSource->GetPushSourceFlags(&flags)) || !(flags & AM_PUSHSOURCECAPS_NOT_LIVE);
+		}
+
+		pPin = pBF ? GetUpStreamPin(pBF) : nullptr;
+	}
+
+	return false;
+}
+
 void CMPCVideoDecFilter::SetThreadCount()
 {
+	m_bAutoThreading = false;
+
 	if (m_pAVCtx) {
 		if (m_bUseNVDEC || m_bUseD3D11cb || m_CodecId == AV_CODEC_ID_MPEG4 || IsDXVASupported(m_bUseDXVA || m_bUseD3D11)) {
 			m_pAVCtx->thread_count = 1;
 			m_pAVCtx->thread_type  = 0;
+		} else if (m_nThreadNumber > 0) {
+			m_pAVCtx->thread_count = std::clamp(m_nThreadNumber, 1, MAX_AUTO_THREADS);
 		} else {
-			int nThreadNumber = (m_nThreadNumber > 0) ? m_nThreadNumber : CPUInfo::GetProcessorNumber();
-			m_pAVCtx->thread_count = std::clamp(nThreadNumber, 1, MAX_AUTO_THREADS);
+			m_pAVCtx->thread_count = std::clamp((int)CPUInfo::GetProcessorNumber(), 1, MAX_AUTO_THREADS);
+
+			// frame threading delays the output by one frame per thread, slice threading does not.
+			// Intra-only codecs gain nothing from frame threading, live sources need a low delay.
+			int thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+			if (!m_bForceFrameThreads && m_pAVCodec && (m_pAVCodec->capabilities & AV_CODEC_CAP_SLICE_THREADS)) {
+				const AVCodecDescriptor* desc = avcodec_descriptor_get(m_CodecId);
+				if (m_bLowLatency || (desc && (desc->props & AV_CODEC_PROP_INTRA_ONLY))) {
+					thread_type = FF_THREAD_SLICE;
+				}
+			}
+			m_pAVCtx->thread_type = thread_type;
+
+			m_bAutoThreading = true;
 		}
 	}
 }
 
+void CMPCVideoDecFilter::UpdateDecodeTime(REFERENCE_TIME rtDecodeTime)
+{
+	m_rtLastDecodeTime = rtDecodeTime;
+	m_rtAvgDecodeTime  = m_nDecodeTimeCount ? (m_rtAvgDecodeTime * 15 + rtDecodeTime) / 16 : rtDecodeTime;
+	m_nDecodeTimeCount++;
+
+	if (!m_pAVCtx || !m_bAutoThreading || m_bThreadsReinit || m_bForceFrameThreads || m_nDecodeTimeCount < 100) {
+		return;
+	}
+
+	const REFERENCE_TIME rtFrameDuration = llrint(GetFrameDuration() / m_dRate);
+	if (rtFrameDuration <= 0 || m_rtAvgDecodeTime * 10 < rtFrameDuration * 9) {
+		return;
+	}
+
+	// decoding does not keep up with the playback, slice threading is not enough
+	if (m_pAVCtx->active_thread_type != FF_THREAD_SLICE || !(m_pAVCodec->capabilities & AV_CODEC_CAP_FRAME_THREADS)) {
+		return;
+	}
+	m_bForceFrameThreads = true;
+
+	DLog(L"CMPCVideoDecFilter::UpdateDecodeTime() : average decoding time %0.3f ms, frame duration %0.3f ms - change threading",
+		 m_rtAvgDecodeTime / 10000.0, rtFrameDuration / 10000.0);
+
+	m_bThreadsReinit = true;
+}
+
 void CMPCVideoDecFilter::GetOutputSize(int& w, int& h, int& arx, int& ary)
 {
 	if (m_pAVCtx) {
@@ -3869,7 +4051,7 @@ HRESULT CMPCVideoDecFilter::Transform(IMediaSample* pIn)
 
 	hr = m_pMSDKDecoder
 		? m_pMSDKDecoder->Decode(buffer, buflen, rtStart, rtStop)
-		: Decode(buffer, buflen, rtStart, rtStop, pIn->IsSyncPoint() == S_OK, pIn->IsPreroll() == S_OK);
+		: Decode(buffer, buflen, rtStart, rtStop, pIn->IsSyncPoint() == S_OK, pIn->IsPreroll() == S_OK, pIn);
 
 	m_bDecodingStart = TRUE;
 
@@ -4578,6 +4760,34 @@ STDMETHODIMP CMPCVideoDecFilter::SetD3D11Adapter(UINT VendorId, UINT DeviceId)
 	return S_OK;
 }
 
+STDMETHODIMP CMPCVideoDecFilter::GetDecodeStats(MPC_DECODE_STATS* pStats)
+{
+	CheckPointer(pStats, E_POINTER);
+
+	CAutoLock cLock(&m_csInitDec);
+
+	if (!m_pAVCtx) {
+		return E_ABORT;
+	}
+
+	switch (m_pAVCtx->active_thread_type) {
+		case FF_THREAD_FRAME: pStats->ThreadingType = THREADING_FRAME; break;
+		case FF_THREAD_SLICE: pStats->ThreadingType = THREADING_SLICE; break;
+		default:              pStats->ThreadingType = THREADING_NONE;
+	}
+	pStats->ThreadCount      = pStats->ThreadingType == THREADING_NONE ? 1 : m_pAVCtx->thread_count;
+	pStats->bLowLatency      = m_bLowLatency;
+	pStats->rtLastDecodeTime = m_rtLastDecodeTime;
+	pStats->rtAvgDecodeTime  = m_rtAvgDecodeTime;
+	pStats->rtFrameDuration  = GetFrameDuration();
+	pStats->nPacketsWrapped  = m_nPacketsWrapped;
+	pStats->nPacketsCopied   = m_nPacketsCopied;
+	pStats->nBytesCopied     = m_nBytesCopied;
+	pStats->nFramesDirect    = m_nFramesDirect;
+
+	return S_OK;
+}
+
 STDMETHODIMP_(CString) CMPCVideoDecFilter::GetInformation(MPCInfo index)
 {
 	CAutoLock cLock(&m_csInitDec);
@@ -4815,6 +5025,184 @@ HRESULT CMPCVideoDecFilter::CheckDXVA2Decoder(AVCodecContext *c)
 	return hr;
 }
 
+int CMPCVideoDecFilter::av_get_buffer_direct(struct AVCodecContext *c, AVFrame *pic, int flags)
+{
+	CMPCVideoDecFilter* pFilter = static_cast<CMPCVideoDecFilter*>(c->opaque);
+
+	// the decoder must not keep the frame as a reference, and with frame threading
+	// this callback is called from the decoding threads
+	if (!(flags & AV_GET_BUFFER_FLAG_REF)
+			&& c->active_thread_type != FF_THREAD_FRAME
+			&& pFilter->GetDirectBuffer(c, pic)) {
+		return 0;
+	}
+
+	return avcodec_default_get_buffer2(c, pic, flags);
+}
+
+void CMPCVideoDecFilter::av_release_direct_buffer(void* opaque, uint8_t* data)
+{
+	CMPCVideoDecFilter* pFilter = static_cast<CMPCVideoDecFilter*>(opaque);
+
+	CAutoLock cLock(&pFilter->m_csDirectSamples);
+	pFilter->m_DirectSamples.erase(data);
+}
+
+// Requests the output sample for the next frame before the packet is sent to the decoder. GetDeliveryBuffer()
+// can block on the downstream allocator and change the output format, neither may happen inside get_buffer2.
+void CMPCVideoDecFilter::PrepareDirectSample()
+{
+	if (!m_bDirectRendering || m_pAVCtx->active_thread_type == FF_THREAD_FRAME
+			|| !m_FormatConverter.DirectCopyPossible(m_pAVCtx->pix_fmt)) {
+		return;
+	}
+
+	{
+		CAutoLock cLock(&m_csDirectSamples);
+		if (m_pDirectSample) {
+			return;
+		}
+	}
+
+	int w = m_pAVCtx->width;
+	int h = m_pAVCtx->height;
+	if (!w || !h) {
+		return;
+	}
+	FixFrameSize(m_pAVCtx, w, h);
+
+	UpdateAspectRatio();
+
+	CComPtr<IMediaSample> pOut;
+	DXVA2_ExtendedFormat dxvaExtFormat = GetDXVA2ExtendedFormat(m_pAVCtx, m_pFrame);
+	if (FAILED(GetDeliveryBuffer(w, h, &pOut, GetFrameDuration(), &dxvaExtFormat))) {
+		return;
+	}
+
+	CAutoLock cLock(&m_csDirectSamples);
+	m_pDirectSample = pOut;
+	m_nDirectWidth  = w;
+	m_nDirectHeight = h;
+}
+
+void CMPCVideoDecFilter::ReleaseDirectSample()
+{
+	CAutoLock cLock(&m_csDirectSamples);
+
+	if (m_pDirectSample) {
+		// a format change attached to the unused sample goes with the next one
+		AM_MEDIA_TYPE* pmt = nullptr;
+		if (SUCCEEDED(m_pDirectSample->GetMediaType(&pmt)) && pmt) {
+			DeleteMediaType(pmt);
+			m_bSendMediaType = true;
+		}
+		m_pDirectSample.Release();
+	}
+}
+
+bool CMPCVideoDecFilter::GetDirectBuffer(AVCodecContext *c, AVFrame *pic)
+{
+	const AVPixelFormat pix_fmt = (AVPixelFormat)pic->format;
+	if (!m_FormatConverter.DirectCopyPossible(pix_fmt)) {
+		return false;
+	}
+
+	int w = c->width;
+	int h = c->height;
+	FixFrameSize(c, w, h);
+
+	CComPtr<IMediaSample> pOut;
+	{
+		CAutoLock cLock(&m_csDirectSamples);
+		if (!m_pDirectSample || m_nDirectWidth != w || m_nDirectHeight != h || pic->width != w || pic->height != h) {
+			return false;
+		}
+		pOut = m_pDirectSample;
+	}
+
+	BYTE* pDataOut = nullptr;
+	if (FAILED(pOut->GetPointer(&pDataOut))) {
+		return false;
+	}
+
+	uint8_t* data[4] = {};
+	int linesize[4] = {};
+	if (!m_FormatConverter.GetDirectPlanes(pDataOut, pix_fmt, data, linesize)) {
+		return false;
+	}
+
+	// check that the decoder can write the aligned picture into the sample
+	int aligned_w = pic->width;
+	int aligned_h = pic->height;
+	int linesize_align[AV_NUM_DATA_POINTERS] = {};
+	avcodec_align_dimensions2(c, &aligned_w, &aligned_h, linesize_align);
+
+	int min_linesize[4] = {};
+	if (av_image_fill_linesizes(min_linesize, pix_fmt, aligned_w) < 0) {
+		return false;
+	}
+
+	// the aligned rows must not overlap the next plane
+	if (aligned_h > m_FormatConverter.GetPlaneHeight()) {
+		DLog(L"CMPCVideoDecFilter::GetDirectBuffer() : the output samples do not fit the decoder alignment, direct rendering disabled");
+		m_bDirectRendering = false;
+		return false;
+	}
+
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+	const uintptr_t align = av_cpu_max_align();
+	const BYTE* pDataEnd = pDataOut + pOut->GetSize();
+	const int planes = av_pix_fmt_count_planes(pix_fmt);
+	for (int i = 0; i < planes; i++) {
+		const int plane_h = (i == 0 || i == 3) ? aligned_h : AV_CEIL_RSHIFT(aligned_h, desc->log2_chroma_h);
+
+		if (linesize[i] < min_linesize[i]
+				|| linesize[i] % linesize_align[i]
+				|| (uintptr_t)data[i] % align
+				|| data[i] + (size_t)linesize[i] * plane_h > pDataEnd) {
+			DLog(L"CMPCVideoDecFilter::GetDirectBuffer() : the output samples do not fit the decoder alignment, direct rendering disabled");
+			m_bDirectRendering = false;
+			return false;
+		}
+	}
+
+	pic->buf[0] = av_buffer_create(pDataOut, pOut->GetSize(), av_release_direct_buffer, this, 0);
+	if (!pic->buf[0]) {
+		return false;
+	}
+
+	{
+		CAutoLock cLock(&m_csDirectSamples);
+		m_DirectSamples[pDataOut] = { pOut, m_FormatConverter.GetDstStride(), m_FormatConverter.GetPlaneHeight() };
+		m_pDirectSample.Release();
+	}
+
+	for (int i = 0; i < 4; i++) {
+		pic->data[i]     = data[i];
+		pic->linesize[i] = linesize[i];
+	}
+	pic->extended_data = pic->data;
+
+	return true;
+}
+
+CComPtr<IMediaSample> CMPCVideoDecFilter::GetDirectSample(const AVFrame *pic)
+{
+	if (pic->buf[0] && av_buffer_get_opaque(pic->buf[0]) == this) {
+		CAutoLock cLock(&m_csDirectSamples);
+
+		// after an output format change the frame is converted from the sample memory like any other frame
+		auto it = m_DirectSamples.find(pic->buf[0]->data);
+		if (it != m_DirectSamples.end()
+				&& it->second.stride == m_FormatConverter.GetDstStride()
+				&& it->second.planeHeight == m_FormatConverter.GetPlaneHeight()) {
+			return it->second.pSample;
+		}
+	}
+
+	return nullptr;
+}
+
 int CMPCVideoDecFilter::av_get_buffer(struct AVCodecContext *c, AVFrame *pic, int flags)
 {
 	CMPCVideoDecFilter* pFilter = static_cast<CMPCVideoDecFilter*>(c->opaque);
@@ -81,6 +81,32 @@ private:
 	AVCodecContext*							m_pAVCtx;
 	AVCodecParserContext*					m_pParser;
 	AVFrame*								m_pFrame;
+	AVPacket*								m_pPacket;				// reused for every input packet
+	bool									m_bZeroCopyPacket = true;
+	UINT64									m_nPacketsWrapped = 0;	// input packets passed to the decoder without a copy
+	UINT64									m_nPacketsCopied  = 0;
+	UINT64									m_nBytesCopied    = 0;
+
+	// === decoder threading
+	bool									m_bAutoThreading     = false;
+	bool									m_bLowLatency        = false;	// live source, frame threading is avoided
+	bool									m_bForceFrameThreads = false;
+	bool									m_bThreadsReinit     = false;	// threading changed, the decoder is reinitialized at the next sync point
+	unsigned								m_nDecodeTimeCount   = 0;
+	REFERENCE_TIME							m_rtLastDecodeTime   = 0;
+	REFERENCE_TIME							m_rtAvgDecodeTime    = 0;
+	REFERENCE_TIME							m_rtDecodeTimeSum    = 0;	// time spent in the decoder for the current input packet
+	struct DirectSample {
+		CComPtr<IMediaSample> pSample;
+		int stride, planeHeight;	// output layout the planes were set for
+	};
+	std::map<BYTE*, DirectSample>			m_DirectSamples;		// output samples used as decoder frame buffers
+	CComPtr<IMediaSample>					m_pDirectSample;		// output sample requested before decoding, for the next frame buffer
+	int										m_nDirectWidth  = 0;
+	int										m_nDirectHeight = 0;
+	bool									m_bDirectRendering = false;	// cleared when the output samples do not fit the decoder alignment
+	UINT64									m_nFramesDirect = 0;	// frames decoded directly into the output sample
+	CCritSec								m_csDirectSamples;
 	enum AVCodecID							m_CodecId;
 	REFERENCE_TIME							m_rtAvrTimePerFrame;
 	bool									m_bCalculateStopTime;
@@ -208,13 +234,15 @@ private:
 	void			DetectVideoCard(HWND hWnd);
 	void			BuildOutputFormat();
 
-	HRESULT			FillAVPacket(AVPacket *avpkt, const BYTE *buffer, int buflen);
+	HRESULT			FillAVPacket(AVPacket *avpkt, const BYTE *buffer, int buflen, IMediaSample* pSample = nullptr);
 	HRESULT			DecodeInternal(AVPacket *avpkt, REFERENCE_TIME rtStartIn, REFERENCE_TIME rtStopIn, BOOL bPreroll = FALSE);
 	HRESULT			ParseInternal(const BYTE *buffer, int buflen, REFERENCE_TIME rtStartIn, REFERENCE_TIME rtStopIn, BOOL bPreroll);
-	HRESULT			Decode(const BYTE *buffer, int buflen, REFERENCE_TIME rtStartIn, REFERENCE_TIME rtStopIn, BOOL bSyncPoint = FALSE, BOOL bPreroll = FALSE);
+	HRESULT			Decode(const BYTE *buffer, int buflen, REFERENCE_TIME rtStartIn, REFERENCE_TIME rtStopIn, BOOL bSyncPoint = FALSE, BOOL bPreroll = FALSE, IMediaSample* pSample = nullptr);
 	HRESULT			ChangeOutputMediaFormat(int nType);
 
+	bool			IsLiveSource();
 	void			SetThreadCount();
+	void			UpdateDecodeTime(REFERENCE_TIME rtDecodeTime);
 	HRESULT			FindDecoderConfiguration();
 
 	HRESULT			InitDecoder(const CMediaType *pmt);
@@ -228,6 +256,13 @@ private:
 	HRESULT						CheckDXVA2Decoder(AVCodecContext *c);
 
 	static int					av_get_buffer(struct AVCodecContext *c, AVFrame *pic, int flags);
+	static int					av_get_buffer_direct(struct AVCodecContext *c, AVFrame *pic, int flags);
+	static void					av_release_direct_buffer(void* opaque, uint8_t* data);
+
+	void						PrepareDirectSample();
+	void						ReleaseDirectSample();
+	bool						GetDirectBuffer(AVCodecContext *c, AVFrame *pic);
+	CComPtr<IMediaSample>		GetDirectSample(const AVFrame *pic);
 	static enum AVPixelFormat	av_get_format(struct AVCodecContext *c, const enum AVPixelFormat* pix_fmts);
 
 	bool						CheckDXVACompatible(const enum AVCodecID codec, const enum AVPixelFormat pix_fmt, const int profile);
@@ -260,6 +295,7 @@ public:
 	HRESULT			EndOfStream();
 
 	HRESULT			BreakConnect(PIN_DIRECTION dir);
+	HRESULT			StopStreaming();
 
 	// === ISpecifyPropertyPages2
 
@@ -304,6 +340,8 @@ public:
 	STDMETHODIMP GetD3D11Adapter(MPC_ADAPTER_ID* pAdapterId);
 	STDMETHODIMP SetD3D11Adapter(UINT VendorId, UINT DeviceId);
 
+	STDMETHODIMP GetDecodeStats(MPC_DECODE_STATS* pStats);
+
 	// IExFilterConfig
 	STDMETHODIMP GetInt(LPCSTR field, int* value) override;
 	STDMETHODIMP GetInt64(LPCSTR field, __int64* value) override;